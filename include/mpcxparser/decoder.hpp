@@ -0,0 +1,106 @@
+/**
+ * @file decoder.hpp
+ * @author Halkaze
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPCXPARSER_DECODER_HPP__
+#define MPCXPARSER_DECODER_HPP__
+
+#include "mpcxparser/mpcxparser.h"
+
+namespace mugen {
+namespace pcx {
+
+// 任意の大きさに分割されたバイト列を順に受け取りながら展開する
+// 展開結果は PcxParser::parse と同じになる
+template <MugenVersion Version>
+class PcxDecoder {
+ public:
+  // y 行目の展開が終わるたびに呼び出される
+  // パレット形式の場合は indexes のみ、24bit 形式の場合は data のみを持つ
+  using RowCallback = std::function<void(std::size_t y, std::span<const std::uint8_t> indexes, std::span<const Pcx::Pixel> data)>;
+
+ private:
+  enum class State {
+    Header,
+    Body,
+    Pallete,
+    Done,
+  };
+
+  RowCallback onRow_;
+
+  State state_;
+
+  // ヘッダーのうち PcxHeaderMinimum より後ろの部分は読み捨てる
+  internal::PcxHeaderMinimum header_;
+  std::size_t headerSize_;
+  std::optional<PcxInfo> info_;
+
+  // 展開中の行と、行内の位置
+  std::size_t y_;
+  std::size_t x_;
+
+  // ランの長さを読み出した後、値がまだ届いていない場合は true
+  bool hasPendingRun_;
+  std::size_t pendingLength_;
+
+  std::vector<std::uint8_t> line_;
+  std::vector<Pcx::Pixel> row_;
+
+  // 受け取った末尾のパレットと、マーカーを含めたそのバイト数
+  internal::PcxPallete tail_;
+  std::size_t tailSize_;
+  PcxPalleteInfo pallete_;
+
+  void begin_body();
+  void finish_row();
+
+  const std::uint8_t* feed_header(const std::uint8_t* p, const std::uint8_t* end);
+  const std::uint8_t* feed_body(const std::uint8_t* p, const std::uint8_t* end);
+  const std::uint8_t* feed_pallete(const std::uint8_t* p, const std::uint8_t* end) noexcept;
+
+ public:
+  PcxDecoder(const PcxDecoder&) = delete;
+  PcxDecoder& operator=(const PcxDecoder&) = delete;
+
+  PcxDecoder(PcxDecoder&&) = default;
+  PcxDecoder& operator=(PcxDecoder&&) = default;
+
+  explicit PcxDecoder(RowCallback onRow);
+
+  // ヘッダーを受け取るまでは std::nullopt
+  inline const std::optional<PcxInfo>& info() const noexcept { return info_; }
+
+  // 続きのバイト列を受け取り、展開の終わった行をコールバックで返す
+  // ヘッダーが MUGEN で読み込めない形式であった場合は IncompatibleFormatError を送出する
+  void feed(std::span<const std::uint8_t> chunk);
+
+  // 入力の終端を通知し、残りの行をコールバックで返してからパレットを返す
+  // 途中で終端に達した場合は parse と同じく、以降は 0xFF が続くものとして扱う
+  // ヘッダーが足りない場合は IllegalFormatError を送出する
+  PcxPalleteInfo finish();
+};
+
+using PcxDecoderWin = PcxDecoder<MugenVersion::Win>;
+
+};  // namespace pcx
+};  // namespace mugen
+
+#endif  // MPCXPARSER_DECODER_HPP__
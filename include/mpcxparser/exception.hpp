@@ -24,9 +24,22 @@
 
 #include "mpcxparser/mpcxparser.h"
 
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+#define MPCXPARSER_EXCEPTIONS 1
+#endif
+
 namespace mugen {
 namespace pcx {
 
+// 例外を送出しない API で返すエラーの種類
+// None 以外はそれぞれ同名の例外クラスに対応する
+enum class ErrorCode {
+  None,
+  FileIOError,
+  IllegalFormatError,
+  IncompatibleFormatError,
+};
+
 class FileIOError : public std::runtime_error {
  public:
   inline explicit FileIOError(const std::string& message) noexcept : std::runtime_error{message} {}
@@ -45,6 +58,20 @@ class IncompatibleFormatError : public std::logic_error {
   inline explicit IncompatibleFormatError(const char* message) noexcept : std::logic_error{message} {}
 };
 
+namespace internal {
+
+// 例外が無効な場合（-fno-exceptions など）は送出する代わりに std::abort する
+template <class Exception>
+[[noreturn]] inline void raise([[maybe_unused]] const char* message) {
+#ifdef MPCXPARSER_EXCEPTIONS
+  throw Exception{message};
+#else
+  std::abort();
+#endif
+}
+
+};  // namespace internal
+
 };  // namespace pcx
 };  // namespace mugen
 
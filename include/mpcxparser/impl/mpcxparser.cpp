@@ -26,99 +26,221 @@
 #endif
 
 #include "mpcxparser/mpcxparser.h"
+#include "mpcxparser/impl/simd.hpp"
 
 #include <bit>
+#include <cstring>
 #include <fstream>
 #include <ios>
-#include <limits>
-#include <streambuf>
+#include <memory>
+#include <system_error>
 #include <utility>
 
 namespace mugen {
 namespace pcx {
 namespace internal {
 
-// C++23 の ispanstream の代替
-class SpanStreamBuf : public std::streambuf {
+// std::istream からまとまった単位で読み出したバッファを走査する
+// 読み出し結果や EOF の扱いは std::istream から 1 バイトずつ読み出した場合と同じになるように振る舞う
+class StreamReader {
+ public:
+  static constexpr std::size_t DEFAULT_CAPACITY = 0x10000;
+
  private:
-  const std::span<std::uint8_t> buf_;
+  std::istream& is_;
 
- public:
-  SpanStreamBuf(const std::span<std::uint8_t>& span) : buf_{span} {
-    auto begin = std::bit_cast<char*>(const_cast<std::uint8_t*>(span.data()));
-    this->setg(begin, begin, begin + span.size());
-  }
-
- protected:
-  pos_type seekoff(off_type offset, std::ios_base::seekdir way, std::ios_base::openmode) override {
-    // Borrowed in part from MSVC's spanstream implementation
-    switch (way) {
-      case std::ios_base::beg:
-        if (static_cast<size_t>(offset) > buf_.size()) {
-          return pos_type{off_type{-1}};
-        }
+  const std::size_t capacity_;
+  const std::unique_ptr<std::uint8_t[]> buf_;
 
-        break;
-      case std::ios_base::end: {
-        const auto baseoff = static_cast<off_type>(buf_.size());
-        if (offset > std::numeric_limits<off_type>::max() - baseoff) {
-          return pos_type{off_type{-1}};
-        }
+  const std::uint8_t* cur_;
+  const std::uint8_t* end_;
+  bool eof_;
+  bool fail_;
 
-        offset += baseoff;
-        if (static_cast<size_t>(offset) > buf_.size()) {
-          return pos_type{off_type{-1}};
-        }
-      } break;
-      case std::ios_base::cur: {
-        const off_type oldoff = static_cast<off_type>(this->gptr() - this->eback());
-        const off_type oldleft = static_cast<off_type>(buf_.size() - oldoff);
-        if (offset < -oldoff || offset > oldleft) {
-          return pos_type{off_type{-1}};
-        }
-        offset += oldoff;
-      } break;
-      default:
-        return pos_type{off_type{-1}};
+  // バッファに次の塊を読み込む
+  // 1 バイトも読み込めなかった場合は false を返す
+  inline bool refill() noexcept {
+    is_.read(std::bit_cast<char*>(buf_.get()), capacity_);
+    auto n = static_cast<std::size_t>(is_.gcount());
+    if (n < capacity_) {
+      // 終端まで読み込んだ場合でも、後続の seekg が失敗しないように状態をリセットする
+      is_.clear(is_.rdstate() & std::ios_base::badbit);
     }
+    cur_ = buf_.get();
+    end_ = cur_ + n;
+    return n != 0;
+  }
+
+ public:
+  inline explicit StreamReader(std::istream& is, std::size_t capacity = DEFAULT_CAPACITY)
+      : is_{is},
+        capacity_{std::max<std::size_t>(capacity, 1)},
+        buf_{new std::uint8_t[capacity_]},
+        cur_{buf_.get()},
+        end_{buf_.get()},
+        eof_{false},
+        fail_{false} {}
+
+  StreamReader(const StreamReader&) = delete;
+  StreamReader& operator=(const StreamReader&) = delete;
 
-    if (offset != 0 && !this->gptr()) {
-      return pos_type{off_type{-1}};
+  // 先読みしたが使わなかった分を戻し、ストリームの位置と状態を 1 バイトずつ読み出した場合に合わせる
+  inline ~StreamReader() {
+    if (cur_ != end_) {
+      is_.clear(is_.rdstate() & std::ios_base::badbit);
+      is_.seekg(-static_cast<std::streamoff>(end_ - cur_), std::ios_base::cur);
     }
+    if (eof_) {
+      is_.setstate(std::ios_base::eofbit);
+    }
+    if (fail_) {
+      is_.setstate(std::ios_base::failbit);
+    }
+  }
 
-    this->gbump(static_cast<int>(offset - (this->gptr() - this->eback())));
+  inline bool read(void* dest, std::size_t n) noexcept {
+    auto p = static_cast<std::uint8_t*>(dest);
+    while (n != 0) {
+      if (fail_ || (cur_ == end_ && !refill())) {
+        eof_ = eof_ || !fail_;
+        fail_ = true;
+        return false;
+      }
+      auto len = std::min<std::size_t>(n, end_ - cur_);
+      std::memcpy(p, cur_, len);
+      p += len;
+      cur_ += len;
+      n -= len;
+    }
+    return true;
+  }
 
-    return pos_type{offset};
+  inline std::uint8_t getc() noexcept {
+    if (cur_ != end_) {
+      return *cur_++;
+    }
+    if (fail_ || !refill()) {
+      eof_ = eof_ || !fail_;
+      fail_ = true;
+      return 0xFF;
+    }
+    return *cur_++;
   }
 
-  pos_type seekpos(pos_type pos, std::ios_base::openmode mode) override { return seekoff(pos, std::ios_base::beg, mode); }
-};
+  inline bool eof() const noexcept { return eof_; }
 
-static inline std::uint8_t getc(std::istream& is) noexcept {
-  std::uint8_t byte = 0;
-  is.read(std::bit_cast<char*>(&byte), 1);
-  if (is.fail()) {
-    return 0xFF;
+  // 読み出し済みで未使用のバイト列を返す（空の場合は次の塊を読み込む）
+  inline std::span<const std::uint8_t> peek() noexcept {
+    if (cur_ == end_ && !fail_) {
+      refill();
+    }
+    return {cur_, end_};
   }
-  return byte;
-}
 
-// EOFに到達した場合はtrueを返す
-static inline bool skip_n(std::istream& is, std::size_t n) noexcept {
-  if (n == 0) {
-    return is.eof();
+  // peek() で返したバイト列のうち、先頭 n バイトを読み出し済みにする
+  inline void consume(std::size_t n) noexcept { cur_ += n; }
+
+  // EOFに到達した場合はtrueを返す
+  inline bool skip_n(std::size_t n) noexcept {
+    if (n == 0) {
+      return eof_;
+    }
+
+    auto remaining = static_cast<std::size_t>(end_ - cur_);
+    if (remaining > n) {
+      cur_ += n;
+      return false;
+    }
+
+    // バッファを越える分はストリーム側で読み飛ばす
+    cur_ = end_;
+    if (remaining < n) {
+      is_.seekg(n - remaining, std::ios_base::cur);
+      if (is_.fail()) {
+        is_.clear(is_.rdstate() & std::ios_base::badbit);
+        fail_ = true;
+        return false;
+      }
+    }
+
+    if (!refill()) {
+      eof_ = true;
+      fail_ = true;
+      return true;
+    }
+    return false;
   }
+};
+
+// 連続したメモリ領域をポインタで直接走査する
+// 終端を越えた読み出しや読み飛ばしは std::istream と同じ結果になるように振る舞う
+//  - 終端を越えて読み出した場合は 0xFF を返し、EOF を立てる
+//  - 終端を越えて読み飛ばした場合は失敗状態となり、以降は EOF を立てずに 0xFF を返す
+class MemoryReader {
+ private:
+  const std::uint8_t* cur_;
+  const std::uint8_t* const end_;
+  bool eof_;
+  bool fail_;
 
-  is.seekg(n, std::ios_base::cur);
-  char p;
-  is.read(&p, 1);
-  if (is.eof()) {
+ public:
+  inline explicit MemoryReader(const std::uint8_t* mem, std::size_t length) noexcept
+      : cur_{mem}, end_{mem + length}, eof_{false}, fail_{false} {}
+
+  inline bool read(void* dest, std::size_t n) noexcept {
+    if (static_cast<std::size_t>(end_ - cur_) < n) {
+      if (cur_ != end_) {
+        std::memcpy(dest, cur_, end_ - cur_);
+      }
+      cur_ = end_;
+      eof_ = true;
+      return false;
+    }
+    std::memcpy(dest, cur_, n);
+    cur_ += n;
     return true;
   }
 
-  is.seekg(-1, std::ios_base::cur);
-  return false;
-}
+  inline std::uint8_t getc() noexcept {
+    if (cur_ == end_) {
+      eof_ = eof_ || !fail_;
+      return 0xFF;
+    }
+    return *cur_++;
+  }
+
+  inline bool eof() const noexcept { return eof_; }
+
+  // 未読のバイト列を返す
+  inline std::span<const std::uint8_t> peek() const noexcept { return {cur_, end_}; }
+
+  // peek() で返したバイト列のうち、先頭 n バイトを読み出し済みにする
+  inline void consume(std::size_t n) noexcept { cur_ += n; }
+
+  // EOFに到達した場合はtrueを返す
+  inline bool skip_n(std::size_t n) noexcept {
+    if (n == 0) {
+      return eof_;
+    }
+
+    auto remaining = static_cast<std::size_t>(end_ - cur_);
+    if (remaining < n) {
+      cur_ = end_;
+      fail_ = true;
+      return false;
+    }
+
+    // n バイト読み飛ばした後に 1 バイトも残っていなければ EOF
+    if (remaining == n) {
+      cur_ = end_;
+      eof_ = true;
+      return true;
+    }
+
+    cur_ += n;
+    return false;
+  }
+};
 
 static inline std::array<Pcx::Pixel, 256> convert_ega_to_pixel(const std::uint8_t (&egaPallete)[16][3]) noexcept {
   std::array<Pcx::Pixel, 256> pallete{};
@@ -138,20 +260,21 @@ static inline std::array<Pcx::Pixel, 256> convert_ega_to_pixel(const std::uint8_
 }
 
 // len または value がEOFであった場合はtrueを返す
-static inline bool pcx_decode(std::istream& is, std::size_t& len, std::uint8_t& value) noexcept {
+template <class Reader>
+static inline bool pcx_decode(Reader& reader, std::size_t& len, std::uint8_t& value) noexcept {
   static constexpr std::uint8_t LEN_MARKER = 0xC0;
 
   len = 1;
-  value = getc(is);
+  value = reader.getc();
 
-  if (is.eof()) {
+  if (reader.eof()) {
     return true;
   }
 
   if ((value & LEN_MARKER) == LEN_MARKER) {
     len = (value & ~LEN_MARKER);
-    value = getc(is);
-    if (is.eof()) {
+    value = reader.getc();
+    if (reader.eof()) {
       return true;
     }
   }
@@ -159,43 +282,135 @@ static inline bool pcx_decode(std::istream& is, std::size_t& len, std::uint8_t&
   return false;
 }
 
-static inline std::vector<std::uint8_t> parse_indexes(std::istream& is,
-                                                      std::size_t size,
-                                                      std::size_t width,
-                                                      std::size_t height,
-                                                      std::size_t bytesPerLine) noexcept {
-  std::vector<std::uint8_t> indexes(size, 0xFF);
+// decode_line の書き込み方
+// 画像ごとに一度だけ選び、行の展開中には分岐しない
+enum class LineMode {
+  Skip,    // 書き込まずに読み飛ばす
+  Direct,  // 行全体をそのまま書き込む（first == 0 && last == bytes）
+  Clip,    // 列 first 以上 last 未満の部分のみを書き込む
+};
 
-  for (std::size_t y = 0; y < height; ++y) {
-    for (std::size_t x = 0; x < bytesPerLine;) {
-      std::size_t len;
-      std::uint8_t value;
-      if (pcx_decode(is, len, value)) {
-        return indexes;
+// 1 行分（bytes バイト）を展開し、列 first 以上 last 未満の部分のみを dest に書き込む
+// 展開途中で EOF に到達した場合は true を返す（EOF に到達したランは書き込まない）
+template <LineMode Mode, class Reader>
+static inline bool decode_line(Reader& reader,
+                               const simd::Kernels& kernels,
+                               std::uint8_t* dest,
+                               std::size_t bytes,
+                               [[maybe_unused]] std::size_t first,
+                               [[maybe_unused]] std::size_t last) noexcept {
+  for (std::size_t x = 0; x < bytes;) {
+    // マーカーを含まないバイト列は長さ 1 のランの連続なので、まとめてコピーする
+    auto window = reader.peek();
+    auto literals = kernels.count_literals(window.data(), std::min<std::size_t>(window.size(), bytes - x));
+    if (literals != 0) {
+      if constexpr (Mode == LineMode::Direct) {
+        std::memcpy(dest + x, window.data(), literals);
+      } else if constexpr (Mode == LineMode::Clip) {
+        auto lo = std::max(x, first);
+        auto hi = std::min(x + literals, last);
+        if (lo < hi) {
+          std::memcpy(dest + (lo - first), window.data() + (lo - x), hi - lo);
+        }
       }
+      reader.consume(literals);
+      x += literals;
+      continue;
+    }
 
-      for (; len != 0; --len) {
-        if (x < width) {
-          indexes[y * width + x] = value;
-        }
-        ++x;
+    std::size_t len;
+    std::uint8_t value;
+    if (pcx_decode(reader, len, value)) {
+      return true;
+    }
+
+    if constexpr (Mode == LineMode::Direct) {
+      kernels.fill_run(dest + x, value, std::min(len, bytes - x));
+    } else if constexpr (Mode == LineMode::Clip) {
+      auto lo = std::max(x, first);
+      auto hi = std::min(x + len, last);
+      if (lo < hi) {
+        kernels.fill_run(dest + (lo - first), value, hi - lo);
       }
     }
+    x += len;
+  }
+
+  return false;
+}
+
+// rows 行分を展開し、各行の列 first 以上 last 未満の部分を stride バイトおきに dest に書き込む
+// 展開途中で EOF に到達した場合は true を返す
+template <LineMode Mode, class Reader>
+static inline bool decode_lines(Reader& reader,
+                                const simd::Kernels& kernels,
+                                std::uint8_t* dest,
+                                std::size_t stride,
+                                std::size_t rows,
+                                std::size_t bytes,
+                                std::size_t first,
+                                std::size_t last) noexcept {
+  for (std::size_t y = 0; y < rows; ++y) {
+    if (decode_line<Mode>(reader, kernels, Mode == LineMode::Skip ? nullptr : dest + y * stride, bytes, first, last)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// 列 first 以上 last 未満を書き込む rows 行分を、適した LineMode で展開する
+template <class Reader>
+static inline bool decode_lines(Reader& reader,
+                                const simd::Kernels& kernels,
+                                std::uint8_t* dest,
+                                std::size_t stride,
+                                std::size_t rows,
+                                std::size_t bytes,
+                                std::size_t first,
+                                std::size_t last) noexcept {
+  if (dest == nullptr) {
+    return decode_lines<LineMode::Skip>(reader, kernels, dest, stride, rows, bytes, first, last);
+  } else if (first == 0 && last == bytes) {
+    return decode_lines<LineMode::Direct>(reader, kernels, dest, stride, rows, bytes, first, last);
+  } else {
+    return decode_lines<LineMode::Clip>(reader, kernels, dest, stride, rows, bytes, first, last);
   }
+}
+
+// dest には region.width * region.height バイトの 0xFF で埋められた領域を渡す
+// region より前の行は書き込まずに読み飛ばし、region の最後の行を展開した時点で読み出しを終える
+// dest が nullptr の場合は書き込まずに読み飛ばす
+template <class Reader>
+static inline void decode_indexes(Reader& reader, std::uint8_t* dest, std::size_t bytesPerLine, const PcxRegion& region) noexcept {
+  const auto& kernels = simd::kernels();
 
+  auto skipped = dest ? region.y : region.y + region.height;
+  if (decode_lines<LineMode::Skip>(reader, kernels, nullptr, 0, skipped, bytesPerLine, 0, 0) || dest == nullptr) {
+    return;
+  }
+  decode_lines(reader, kernels, dest, region.width, region.height, bytesPerLine, region.x, region.x + region.width);
+}
+
+template <class Reader>
+static inline std::vector<std::uint8_t> parse_indexes(Reader& reader, std::size_t bytesPerLine, const PcxRegion& region) noexcept {
+  std::vector<std::uint8_t> indexes(region.width * region.height, 0xFF);
+  decode_indexes(reader, indexes.data(), bytesPerLine, region);
   return indexes;
 }
 
-static inline std::array<Pcx::Pixel, 256> parse_pallete(std::istream& is, const std::uint8_t (&egaPallete)[16][3]) noexcept {
+// 本体に続く 256 色パレットを探して読み出す
+// マーカーより前に 0 以外のバイトがあった場合は std::nullopt を返す
+template <class Reader>
+static inline std::optional<std::array<Pcx::Pixel, 256>> find_pallete(Reader& reader) noexcept {
   static constexpr std::uint8_t PAL_MARKER = 0x0C;
 
   std::uint8_t markerByte = 0;
   while (true) {
-    markerByte = getc(is);
+    markerByte = reader.getc();
     if (markerByte == PAL_MARKER) {
       break;
     } else if (markerByte != 0) {
-      return convert_ega_to_pixel(egaPallete);
+      return std::nullopt;
     }
   }
 
@@ -203,129 +418,968 @@ static inline std::array<Pcx::Pixel, 256> parse_pallete(std::istream& is, const
   pallete[0].alpha = 0;
 
   for (std::size_t i = 0; i < pallete.size(); ++i) {
-    pallete[i].red = getc(is);
-    pallete[i].green = getc(is);
-    pallete[i].blue = getc(is);
+    pallete[i].red = reader.getc();
+    pallete[i].green = reader.getc();
+    pallete[i].blue = reader.getc();
   }
 
   return pallete;
 }
 
-static inline std::vector<Pcx::Pixel> parse_data(std::istream& is,
-                                                 std::size_t size,
-                                                 std::size_t width,
-                                                 std::size_t height,
-                                                 std::size_t bytesPerLine) noexcept {
-  std::vector<Pcx::Pixel> data(size);
+template <class Reader>
+static inline std::array<Pcx::Pixel, 256> parse_pallete(Reader& reader, const std::uint8_t (&egaPallete)[16][3]) noexcept {
+  if (auto pallete = find_pallete(reader)) {
+    return *pallete;
+  }
+  return convert_ega_to_pixel(egaPallete);
+}
 
-  std::size_t bytes = bytesPerLine * 3;
-  for (std::size_t y = 0; y < height; ++y) {
-    std::size_t planeIndex = 0;
-    std::size_t planeX = 0;
-    for (std::size_t x = 0; x < bytes;) {
-      std::size_t len;
-      std::uint8_t value;
-      pcx_decode(is, len, value);
-
-      for (; len != 0; --len) {
-        if (planeX < width) {
-          switch (planeIndex) {
-            case 0:
-              data[y * width + planeX].red = value;
-              break;
-            case 1:
-              data[y * width + planeX].green = value;
-              break;
-            case 2:
-              data[y * width + planeX].blue = value;
-              break;
-          }
-        }
-        ++x;
-        if (x == bytesPerLine) {
-          planeIndex = 1;
-          planeX = 0;
-        } else if (x == bytesPerLine * 2) {
-          planeIndex = 2;
-          planeX = 0;
-        } else {
-          ++planeX;
-        }
+// 3 プレーン分の 1 行（bytes バイト）を dest にプレーンの並びのまま展開する
+// 最後のランが行末をはみ出した場合はその分も書き込むため、dest には bytes + 0x3F バイトが必要
+// EOF 以降は 0xFF が続くものとして扱う
+// 戻り値は展開したバイト数（はみ出した分を含む）
+template <class Reader>
+static inline std::size_t decode_planes(Reader& reader, const simd::Kernels& kernels, std::uint8_t* dest, std::size_t bytes) noexcept {
+  std::size_t x = 0;
+  while (x < bytes) {
+    auto window = reader.peek();
+    auto literals = kernels.count_literals(window.data(), std::min<std::size_t>(window.size(), bytes - x));
+    if (literals != 0) {
+      std::memcpy(dest + x, window.data(), literals);
+      reader.consume(literals);
+      x += literals;
+      continue;
+    }
+
+    std::size_t len;
+    std::uint8_t value;
+    bool eof = pcx_decode(reader, len, value);
+
+    kernels.fill_run(dest + x, value, len);
+    x += len;
+
+    if (eof) {
+      // 以降は長さ 1 の 0xFF のランが続く
+      if (x < bytes) {
+        kernels.fill_run(dest + x, 0xFF, bytes - x);
+        x = bytes;
       }
+      break;
     }
   }
 
+  return x;
+}
+
+// decode_planes で decoded バイト展開した 1 行から、列 first 以上 last 未満を RGBA に並べ替えて row に書き込む
+// row には last - first 要素の Pcx::Pixel{} で埋められた領域を渡す
+static inline void interleave_line(const simd::Kernels& kernels,
+                                   const std::uint8_t* line,
+                                   std::size_t decoded,
+                                   std::size_t width,
+                                   std::size_t bytesPerLine,
+                                   std::size_t first,
+                                   std::size_t last,
+                                   Pcx::Pixel* row) noexcept {
+  const auto* red = line;
+  const auto* green = red + bytesPerLine;
+  const auto* blue = green + bytesPerLine;
+
+  auto n = std::min(width, bytesPerLine);
+  if (first < n) {
+    kernels.interleave_rgb(red + first, green + first, blue + first, std::bit_cast<std::uint8_t*>(row), std::min(n, last) - first);
+  }
+
+  // bytesPerLine が width より小さい場合、行末をはみ出したランは B プレーンの続きとして扱われる
+  auto blueEnd = std::min({width, last, decoded - bytesPerLine * 2});
+  for (auto x = std::max(n, first); x < blueEnd; ++x) {
+    row[x - first].blue = blue[x];
+  }
+}
+
+// dest には region.width * region.height 要素の Pcx::Pixel{} で埋められた領域を、
+// line には 1 行分の作業領域（bytesPerLine * 3 + 0x3F バイト）を渡す
+// region より前の行は書き込まずに読み飛ばし、region の最後の行を展開した時点で読み出しを終える
+template <class Reader>
+static inline void decode_data(Reader& reader,
+                               Pcx::Pixel* dest,
+                               std::size_t width,
+                               std::size_t bytesPerLine,
+                               const PcxRegion& region,
+                               std::uint8_t* line) noexcept {
+  // 1 行分を R/G/B のプレーンのまま展開してから、まとめて RGBA に並べ替える
+  std::size_t bytes = bytesPerLine * 3;
+
+  const auto& kernels = simd::kernels();
+
+  // EOF に到達した場合、以降の行は EOF 以降の 0xFF として decode_planes で展開される
+  decode_lines<LineMode::Skip>(reader, kernels, nullptr, 0, region.y, bytes, 0, 0);
+
+  if (region.x == 0 && region.width == width && bytesPerLine >= width) {
+    // 行全体を展開し、行末をはみ出したランも無視できる場合は、そのまま並べ替える
+    for (std::size_t y = 0; y < region.height; ++y) {
+      decode_planes(reader, kernels, line, bytes);
+      kernels.interleave_rgb(line, line + bytesPerLine, line + bytesPerLine * 2, std::bit_cast<std::uint8_t*>(dest + y * width), width);
+    }
+    return;
+  }
+
+  for (std::size_t y = 0; y < region.height; ++y) {
+    auto decoded = decode_planes(reader, kernels, line, bytes);
+    interleave_line(kernels, line, decoded, width, bytesPerLine, region.x, region.x + region.width, dest + y * region.width);
+  }
+}
+
+template <class Reader>
+static inline std::vector<Pcx::Pixel> parse_data(Reader& reader, std::size_t width, std::size_t bytesPerLine, const PcxRegion& region) noexcept {
+  std::vector<Pcx::Pixel> data(region.width * region.height);
+  std::vector<std::uint8_t> line(bytesPerLine * 3 + 0x3F);
+  decode_data(reader, data.data(), width, bytesPerLine, region, line.data());
   return data;
 }
 
-static inline Pcx parse_pcx(std::istream& is) {
-  PcxHeaderMinimum header{};
+// decode_planes で decoded バイト展開した 1 行から、列 first 以上 last 未満をプレーンごとに書き込む
+// interleave_line と同じく、bytesPerLine を超えた列の R/G は 0 のまま残す
+static inline void split_line(const std::uint8_t* line,
+                              std::size_t decoded,
+                              std::size_t width,
+                              std::size_t bytesPerLine,
+                              std::size_t first,
+                              std::size_t last,
+                              Pcx::Planes& planes,
+                              std::size_t offset) noexcept {
+  const auto* red = line;
+  const auto* green = red + bytesPerLine;
+  const auto* blue = green + bytesPerLine;
 
-  is.read(std::bit_cast<char*>(&header), sizeof(header));
-  if (is.fail()) {
-    throw IllegalFormatError{"The given PCX structure is too small."};
+  auto n = std::min({width, bytesPerLine, last});
+  if (first < n) {
+    std::memcpy(planes.red.data() + offset, red + first, n - first);
+    std::memcpy(planes.green.data() + offset, green + first, n - first);
+  }
+
+  auto blueEnd = std::min({width, last, decoded - bytesPerLine * 2});
+  if (first < blueEnd) {
+    std::memcpy(planes.blue.data() + offset, blue + first, blueEnd - first);
+  }
+}
+
+// 24bit 形式は 1 行ごとに R/G/B のプレーンとして格納されているため、並べ替えずにそのまま書き込む
+template <class Reader>
+static inline Pcx::Planes parse_planes(Reader& reader, std::size_t width, std::size_t bytesPerLine, const PcxRegion& region) noexcept {
+  auto size = region.width * region.height;
+  Pcx::Planes planes{
+      .red = std::vector<std::uint8_t>(size),
+      .green = std::vector<std::uint8_t>(size),
+      .blue = std::vector<std::uint8_t>(size),
+      .alpha = std::vector<std::uint8_t>(size, 0xFF),
+  };
+
+  std::size_t bytes = bytesPerLine * 3;
+  std::vector<std::uint8_t> line(bytes + 0x3F);
+
+  const auto& kernels = simd::kernels();
+  decode_lines<LineMode::Skip>(reader, kernels, nullptr, 0, region.y, bytes, 0, 0);
+
+  for (std::size_t y = 0; y < region.height; ++y) {
+    auto decoded = decode_planes(reader, kernels, line.data(), bytes);
+    split_line(line.data(), decoded, width, bytesPerLine, region.x, region.x + region.width, planes, y * region.width);
   }
+  return planes;
+}
+
+// lut には pack_pallete で RGBA8888 に変換したパレットを渡す
+static inline void expand_indexes(const std::uint8_t* indexes, const std::array<std::uint32_t, 256>& lut, Pcx::Pixel* dest, std::size_t n) noexcept {
+  simd::kernels().lookup(indexes, lut.data(), std::bit_cast<std::uint8_t*>(dest), n);
+}
+
+// エラーの種類に対応する例外を送出する
+[[noreturn]] static inline void throw_error(ErrorCode error) {
+  switch (error) {
+    case ErrorCode::FileIOError:
+      raise<FileIOError>("The given PCX does not exist.");
+    case ErrorCode::IllegalFormatError:
+      raise<IllegalFormatError>("The given PCX structure is too small.");
+    default:
+      raise<IncompatibleFormatError>("The given PCX structure is not available in MUGEN.");
+  }
+}
+
+// パスが読み込み可能なファイルを指しているか確認する
+static inline ErrorCode check_file(const std::filesystem::path& pcx) noexcept {
+  std::error_code ec;
+  return std::filesystem::is_regular_file(pcx, ec) ? ErrorCode::None : ErrorCode::FileIOError;
+}
+
+static inline void validate_file(const std::filesystem::path& pcx) {
+  if (auto error = check_file(pcx); error != ErrorCode::None) {
+    throw_error(error);
+  }
+}
+
+// MUGEN のバージョンごとの読み込み規則
+template <MugenVersion Version>
+struct VersionRules;
+
+template <>
+struct VersionRules<MugenVersion::Win> {
+  static constexpr bool trueColor = true;  // 24bit 形式を読み込めるか
+};
 
+// MUGENで読み込み可能な形式か検証する
+template <MugenVersion Version>
+static inline ErrorCode check_header(const PcxHeaderMinimum& header) noexcept {
   auto width = static_cast<std::size_t>(header.endX - header.startX + 1);
   auto height = static_cast<std::size_t>(header.endY - header.startY + 1);
   auto size = width * height;
 
-  if (header.bitsPerPixel != 8 || (header.colorPlanes != 1 && header.colorPlanes != 3) || size == 0) {
-    throw IncompatibleFormatError{"The given PCX structure is not available in MUGEN."};
+  bool planes = header.colorPlanes == 1 || (VersionRules<Version>::trueColor && header.colorPlanes == 3);
+  if (header.bitsPerPixel != 8 || !planes || size == 0) {
+    return ErrorCode::IncompatibleFormatError;
+  }
+  return ErrorCode::None;
+}
+
+template <MugenVersion Version>
+static inline void validate_header(const PcxHeaderMinimum& header) {
+  if (auto error = check_header<Version>(header); error != ErrorCode::None) {
+    throw_error(error);
+  }
+}
+
+// ヘッダーを読み出し、MUGENで読み込み可能な形式か検証する
+template <MugenVersion Version, class Reader>
+static inline ErrorCode try_read_header(Reader& reader, PcxHeaderMinimum& header) noexcept {
+  if (!reader.read(&header, sizeof(header))) {
+    return ErrorCode::IllegalFormatError;
+  }
+  return check_header<Version>(header);
+}
+
+template <MugenVersion Version, class Reader>
+static inline PcxHeaderMinimum read_header(Reader& reader) {
+  PcxHeaderMinimum header{};
+  if (auto error = try_read_header<Version>(reader, header); error != ErrorCode::None) {
+    throw_error(error);
+  }
+  return header;
+}
+
+// ヘッダー部分のみをストリームから直接読み出す
+// 読み出し後はストリームの位置を元に戻す
+template <MugenVersion Version>
+static inline PcxHeaderMinimum peek_header(std::istream& is) {
+  PcxHeaderMinimum header{};
+
+  auto pos = is.tellg();
+  is.read(std::bit_cast<char*>(&header), sizeof(header));
+  if (is.fail()) {
+    throw_error(ErrorCode::IllegalFormatError);
+  }
+  if (pos != std::istream::pos_type{-1}) {
+    is.seekg(pos);
+  }
+
+  validate_header<Version>(header);
+
+  return header;
+}
+
+static inline PcxInfo to_info(const PcxHeaderMinimum& header) noexcept {
+  return PcxInfo{
+      .width = static_cast<std::size_t>(header.endX - header.startX + 1),
+      .height = static_cast<std::size_t>(header.endY - header.startY + 1),
+      .bytesPerLine = header.bytesPerLine,
+      .colorPlanes = header.colorPlanes,
+  };
+}
+
+// region を画像の範囲に切り詰める
+// 画像と重なる部分が無い場合は std::invalid_argument を送出する
+static inline PcxRegion clip_region(const PcxInfo& info, const PcxRegion& region) {
+  if (region.x >= info.width || region.y >= info.height || region.width == 0 || region.height == 0) {
+    raise<std::invalid_argument>("The given region is out of the PCX.");
+  }
+  return PcxRegion{
+      .x = region.x,
+      .y = region.y,
+      .width = std::min(region.width, info.width - region.x),
+      .height = std::min(region.height, info.height - region.y),
+  };
+}
+
+// tail は末尾の sizeof(PcxPallete) バイト（ヘッダーとパレットが収まらない場合は nullptr）
+static inline PcxPalleteInfo to_pallete_info(const PcxHeaderMinimum& header, const PcxPallete* tail) noexcept {
+  static constexpr std::uint8_t PAL_MARKER = 0x0C;
+
+  if (header.colorPlanes != 1) {
+    return PcxPalleteInfo{.pallete = std::nullopt, .isEga = false};
+  }
+  if (tail == nullptr || tail->marker != PAL_MARKER) {
+    return PcxPalleteInfo{.pallete = convert_ega_to_pixel(header.pallete), .isEga = true};
+  }
+
+  std::array<Pcx::Pixel, 256> pallete{};
+  pallete[0].alpha = 0;
+
+  for (std::size_t i = 0; i < pallete.size(); ++i) {
+    pallete[i].red = tail->pal[i].red;
+    pallete[i].green = tail->pal[i].green;
+    pallete[i].blue = tail->pal[i].blue;
+  }
+
+  return PcxPalleteInfo{.pallete = pallete, .isEga = false};
+}
+
+template <MugenVersion Version>
+static inline PcxPalleteInfo read_tail_pallete(const std::uint8_t* mem, std::size_t length) {
+  MemoryReader reader{mem, length};
+  auto header = read_header<Version>(reader);
+
+  if (length < sizeof(PcxHeader) + sizeof(PcxPallete)) {
+    return to_pallete_info(header, nullptr);
+  }
+
+  PcxPallete tail{};
+  std::memcpy(&tail, mem + length - sizeof(tail), sizeof(tail));
+  return to_pallete_info(header, &tail);
+}
+
+// 読み出し後はストリームの位置を元に戻す（シークできないストリームを除く）
+template <MugenVersion Version>
+static inline PcxPalleteInfo read_tail_pallete(std::istream& is) {
+  auto pos = is.tellg();
+  if (pos == std::istream::pos_type{-1}) {
+    StreamReader reader{is};
+    auto header = read_header<Version>(reader);
+    if (header.colorPlanes != 1 || reader.skip_n(sizeof(PcxHeader) - sizeof(PcxHeaderMinimum))) {
+      return to_pallete_info(header, nullptr);
+    }
+
+    decode_indexes(reader, nullptr, header.bytesPerLine, clip_region(to_info(header), PcxRegion{}));
+    if (auto pallete = find_pallete(reader)) {
+      return PcxPalleteInfo{.pallete = *pallete, .isEga = false};
+    }
+    return to_pallete_info(header, nullptr);
+  }
+
+  auto header = peek_header<Version>(is);
+
+  PcxPallete tail{};
+  bool hasTail = false;
+  if (header.colorPlanes == 1 && is.seekg(0, std::ios_base::end)) {
+    auto end = is.tellg();
+    if (end != std::istream::pos_type{-1} && end - pos >= static_cast<std::streamoff>(sizeof(PcxHeader) + sizeof(PcxPallete))) {
+      is.seekg(end - static_cast<std::streamoff>(sizeof(tail)));
+      hasTail = static_cast<bool>(is.read(std::bit_cast<char*>(&tail), sizeof(tail)));
+    }
   }
+  is.clear();
+  is.seekg(pos);
+
+  return to_pallete_info(header, hasTail ? &tail : nullptr);
+}
 
-  if (skip_n(is, sizeof(PcxHeader) - sizeof(PcxHeaderMinimum))) {
-    return Pcx{width, height, header.bytesPerLine, convert_ega_to_pixel(header.pallete), std::vector<std::uint8_t>(size, 0xFF)};
+// palleteCache が指定されていれば、同じ内容の共有パレットを取り出す
+static inline Pcx::SharedPallete share_pallete(const ParseOptions& options, std::array<Pcx::Pixel, 256>&& pallete) {
+  if (options.palleteCache) {
+    return options.palleteCache->intern(pallete);
+  }
+  return std::make_shared<const std::optional<std::array<Pcx::Pixel, 256>>>(std::move(pallete));
+}
+
+// ヘッダーに続く本体から region の範囲を展開する
+// パレットは本体を展開した後に readPallete() で読み出す
+template <class Reader, class PalleteReader>
+static inline Pcx decode_pcx(Reader& reader,
+                             const PcxHeaderMinimum& header,
+                             const PcxRegion& region,
+                             const ParseOptions& options,
+                             PalleteReader&& readPallete) {
+  auto info = to_info(header);
+
+  // 行末の余白（bytesPerLine - width）は切り出した後も保つ
+  auto bytesPerLine = info.bytesPerLine >= info.width ? region.width + (info.bytesPerLine - info.width) : std::min(info.bytesPerLine, region.width);
+
+  if (reader.skip_n(sizeof(PcxHeader) - sizeof(PcxHeaderMinimum))) {
+    return Pcx{region.width,
+               region.height,
+               bytesPerLine,
+               share_pallete(options, convert_ega_to_pixel(header.pallete)),
+               std::vector<std::uint8_t>(region.width * region.height, 0xFF),
+               options.dataExpansion,
+               options.pixelLayout};
   }
 
   if (header.colorPlanes == 1) {
-    auto indexes = parse_indexes(is, size, width, height, header.bytesPerLine);
-    auto pallete = parse_pallete(is, header.pallete);
-    return Pcx{width, height, header.bytesPerLine, std::move(pallete), std::move(indexes)};
+    auto indexes = parse_indexes(reader, info.bytesPerLine, region);
+    auto pallete = readPallete();
+    return Pcx{region.width,
+               region.height,
+               bytesPerLine,
+               share_pallete(options, std::move(pallete)),
+               std::move(indexes),
+               options.dataExpansion,
+               options.pixelLayout};
+  } else if (options.pixelLayout == PixelLayout::Planar) {
+    auto planes = parse_planes(reader, info.width, info.bytesPerLine, region);
+    return Pcx{region.width, region.height, bytesPerLine, std::move(planes)};
+  } else {
+    auto data = parse_data(reader, info.width, info.bytesPerLine, region);
+    return Pcx{region.width, region.height, bytesPerLine, std::move(data)};
+  }
+}
+
+template <MugenVersion Version, class Reader>
+static inline ParseResult try_parse_pcx(Reader& reader, const ParseOptions& options) {
+  PcxHeaderMinimum header{};
+  if (auto error = try_read_header<Version>(reader, header); error != ErrorCode::None) {
+    return ParseResult{.pcx = std::nullopt, .error = error};
+  }
+
+  auto info = to_info(header);
+  auto region = PcxRegion{.x = 0, .y = 0, .width = info.width, .height = info.height};
+  return ParseResult{
+      .pcx = decode_pcx(reader, header, region, options, [&]() noexcept { return parse_pallete(reader, header.pallete); }),
+      .error = ErrorCode::None,
+  };
+}
+
+// try_parse の結果を取り出し、失敗していた場合は例外を送出する
+static inline Pcx unwrap(ParseResult&& result) {
+  if (!result) {
+    throw_error(result.error);
+  }
+  return std::move(*result.pcx);
+}
+
+// region の最後の行を展開した時点で本体の読み出しを終えるため、パレットは readPallete() で末尾から読み出す
+template <MugenVersion Version, class Reader, class PalleteReader>
+static inline Pcx parse_pcx_region(Reader& reader, const PcxRegion& region, const ParseOptions& options, PalleteReader&& readPallete) {
+  auto header = read_header<Version>(reader);
+  return decode_pcx(reader, header, clip_region(to_info(header), region), options, readPallete);
+}
+
+// 1 行ずつ展開して onRow に渡す
+// パレット形式の場合は、本体を展開する前に readPallete() でパレットを読み出す
+template <MugenVersion Version, class Reader, class PalleteReader>
+static inline void parse_pcx_rows(Reader& reader,
+                                  const ParseOptions& options,
+                                  PalleteReader&& readPallete,
+                                  const std::function<void(const PcxRow&)>& onRow) {
+  auto header = read_header<Version>(reader);
+  auto info = to_info(header);
+
+  bool headerOnly = reader.skip_n(sizeof(PcxHeader) - sizeof(PcxHeaderMinimum));
+  if (headerOnly || header.colorPlanes == 1) {
+    // ヘッダーしかない場合は parse と同じく、EGA パレットと 0xFF のインデックスを持つものとして扱う
+    auto pallete = headerOnly ? convert_ega_to_pixel(header.pallete) : readPallete();
+    auto expand = options.dataExpansion != DataExpansion::None;
+
+    std::vector<std::uint8_t> indexes(info.width);
+    std::vector<Pcx::Pixel> data(expand ? info.width : 0);
+    auto lut = simd::pack_pallete(pallete, PixelFormat::RGBA8888);
+
+    const auto& kernels = simd::kernels();
+    bool eof = headerOnly;
+    for (std::size_t y = 0; y < info.height; ++y) {
+      std::fill(indexes.begin(), indexes.end(), 0xFF);
+      if (!eof) {
+        eof = decode_lines(reader, kernels, indexes.data(), info.width, 1, info.bytesPerLine, 0, info.width);
+      }
+      if (expand) {
+        expand_indexes(indexes.data(), lut, data.data(), info.width);
+      }
+      onRow(PcxRow{.y = y, .indexes = indexes, .data = data});
+    }
   } else {
-    auto data = parse_data(is, size, width, height, header.bytesPerLine);
-    return Pcx{width, height, header.bytesPerLine, std::move(data)};
+    std::vector<std::uint8_t> line(info.line_size());
+    std::vector<Pcx::Pixel> data(info.width);
+
+    const auto& kernels = simd::kernels();
+    for (std::size_t y = 0; y < info.height; ++y) {
+      auto decoded = decode_planes(reader, kernels, line.data(), info.bytesPerLine * 3);
+      std::fill(data.begin(), data.end(), Pcx::Pixel{});
+      interleave_line(kernels, line.data(), decoded, info.width, info.bytesPerLine, 0, info.width, data.data());
+      onRow(PcxRow{.y = y, .indexes = {}, .data = data});
+    }
+  }
+}
+
+template <MugenVersion Version, class Reader>
+static inline PcxInfo parse_pcx_into(Reader& reader, const PcxBuffers& buffers) {
+  auto header = read_header<Version>(reader);
+  auto info = to_info(header);
+
+  if ((!buffers.indexes.empty() && buffers.indexes.size() < info.size()) || (!buffers.pallete.empty() && buffers.pallete.size() < 256) ||
+      (!buffers.data.empty() && buffers.data.size() < info.size()) || (!buffers.packed.empty() && buffers.packed.size() < info.size())) {
+    raise<std::invalid_argument>("The given buffer is too small for the PCX.");
+  }
+
+  // 24bit 形式は作業領域が無ければ展開できないが、確保はせずに呼び出し元に渡させる
+  if (header.colorPlanes == 3 && (!buffers.data.empty() || !buffers.packed.empty()) && buffers.line.size() < info.line_size()) {
+    raise<std::invalid_argument>("The given line buffer is too small for the 24-bit PCX.");
+  }
+
+  auto* indexes = buffers.indexes.empty() ? nullptr : buffers.indexes.data();
+  auto* data = buffers.data.empty() ? nullptr : buffers.data.data();
+  auto* packed = buffers.packed.empty() ? nullptr : buffers.packed.data();
+
+  const auto& kernels = simd::kernels();
+
+  std::array<Pcx::Pixel, 256> pallete{};
+  bool paletted = header.colorPlanes == 1;
+
+  if (reader.skip_n(sizeof(PcxHeader) - sizeof(PcxHeaderMinimum))) {
+    // ヘッダーしかない場合は parse と同じく、EGA パレットと 0xFF のインデックスを持つものとして扱う
+    pallete = convert_ega_to_pixel(header.pallete);
+    if (indexes) {
+      std::fill_n(indexes, info.size(), 0xFF);
+    }
+    if (data) {
+      std::fill_n(data, info.size(), pallete[0xFF]);
+    }
+    if (packed) {
+      std::fill_n(packed, info.size(), simd::pack_pallete(pallete, buffers.packedFormat)[0xFF]);
+    }
+    paletted = true;
+  } else if (paletted) {
+    // インデックスの展開先が無い場合、RGBA の展開先の末尾 1/4 に展開してから前方に向かって展開する
+    // （i 番目のピクセルの書き込み先は i + 1 番目以降のインデックスと重ならない）
+    auto* dest = indexes;
+    if (!dest && (data || packed)) {
+      dest = (data ? std::bit_cast<std::uint8_t*>(data) : std::bit_cast<std::uint8_t*>(packed)) + info.size() * 3;
+    }
+    if (dest) {
+      std::fill_n(dest, info.size(), 0xFF);
+    }
+    decode_indexes(reader, dest, info.bytesPerLine, clip_region(info, PcxRegion{}));
+    pallete = parse_pallete(reader, header.pallete);
+
+    // インデックスが data の末尾にある場合もあるため、先に packed に書き込む
+    if (packed) {
+      auto lut = simd::pack_pallete(pallete, buffers.packedFormat);
+      kernels.lookup(dest, lut.data(), std::bit_cast<std::uint8_t*>(packed), info.size());
+    }
+    if (data) {
+      expand_indexes(dest, simd::pack_pallete(pallete, PixelFormat::RGBA8888), data, info.size());
+    }
+  } else if (data || packed) {
+    // data が無い場合は packed に RGBA の並びで展開してから並べ替える
+    auto* dest = data ? data : std::bit_cast<Pcx::Pixel*>(packed);
+    std::fill_n(dest, info.size(), Pcx::Pixel{});
+    decode_data(reader, dest, info.width, info.bytesPerLine, clip_region(info, PcxRegion{}), buffers.line.data());
+    if (packed) {
+      kernels.swizzle(std::bit_cast<const std::uint8_t*>(dest), std::bit_cast<std::uint8_t*>(packed), info.size(), buffers.packedFormat);
+    }
   }
+
+  if (paletted && !buffers.pallete.empty()) {
+    std::copy(pallete.cbegin(), pallete.cend(), buffers.pallete.begin());
+  }
+
+  return info;
 }
 
 };  // namespace internal
 };  // namespace pcx
 };  // namespace mugen
 
-template <>
-MPCXPARSER_INLINE mugen::pcx::PcxParserWin::PcxParser() noexcept {}
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::PcxParser<Version>::PcxParser() noexcept : options_{} {}
 
-template <>
-MPCXPARSER_INLINE mugen::pcx::Pcx mugen::pcx::PcxParserWin::parse(std::istream& is) const {
-  return mugen::pcx::internal::parse_pcx(is);
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::PcxParser<Version>::PcxParser(const ParseOptions& options) noexcept : options_{options} {}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::ParseResult mugen::pcx::PcxParser<Version>::try_parse(std::istream& is) const {
+  mugen::pcx::internal::StreamReader reader{is};
+  return mugen::pcx::internal::try_parse_pcx<Version>(reader, options_);
 }
 
-template <>
-MPCXPARSER_INLINE mugen::pcx::Pcx mugen::pcx::PcxParserWin::parse(const std::filesystem::path& pcx) const {
-  if (!std::filesystem::exists(pcx) || !std::filesystem::is_regular_file(pcx)) {
-    throw FileIOError{"The given PCX does not exist."};
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::ParseResult mugen::pcx::PcxParser<Version>::try_parse(const std::filesystem::path& pcx) const {
+  if (auto error = mugen::pcx::internal::check_file(pcx); error != ErrorCode::None) {
+    return ParseResult{.pcx = std::nullopt, .error = error};
   }
+  // サイズが分かっている場合は一度に全体を読み込む
+  std::error_code ec;
+  auto size = std::filesystem::file_size(pcx, ec);
+  auto capacity = ec ? mugen::pcx::internal::StreamReader::DEFAULT_CAPACITY : static_cast<std::size_t>(size);
+
   auto ifs = std::ifstream{pcx, std::ios_base::binary};
-  return mugen::pcx::internal::parse_pcx(ifs);
+  mugen::pcx::internal::StreamReader reader{ifs, capacity};
+  return mugen::pcx::internal::try_parse_pcx<Version>(reader, options_);
 }
 
-template <>
+template <mugen::pcx::MugenVersion Version>
 template <std::size_t Extent>
-MPCXPARSER_INLINE mugen::pcx::Pcx mugen::pcx::PcxParserWin::parse(std::span<std::uint8_t, Extent> mem) const {
-  mugen::pcx::internal::SpanStreamBuf sbuf{mem};
-  std::istream is{&sbuf};
-  return mugen::pcx::internal::parse_pcx(is);
+MPCXPARSER_INLINE mugen::pcx::ParseResult mugen::pcx::PcxParser<Version>::try_parse(std::span<std::uint8_t, Extent> mem) const {
+  mugen::pcx::internal::MemoryReader reader{mem.data(), mem.size()};
+  return mugen::pcx::internal::try_parse_pcx<Version>(reader, options_);
 }
 
-template <>
-MPCXPARSER_INLINE mugen::pcx::Pcx mugen::pcx::PcxParserWin::parse(const std::uint8_t* mem, std::size_t length) const {
-  auto span = std::span(const_cast<std::uint8_t*>(mem), length);
-  mugen::pcx::internal::SpanStreamBuf sbuf{span};
-  std::istream is{&sbuf};
-  return mugen::pcx::internal::parse_pcx(is);
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::ParseResult mugen::pcx::PcxParser<Version>::try_parse(const std::uint8_t* mem, std::size_t length) const {
+  mugen::pcx::internal::MemoryReader reader{mem, length};
+  return mugen::pcx::internal::try_parse_pcx<Version>(reader, options_);
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::Pcx mugen::pcx::PcxParser<Version>::parse(std::istream& is) const {
+  return mugen::pcx::internal::unwrap(try_parse(is));
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::Pcx mugen::pcx::PcxParser<Version>::parse(const std::filesystem::path& pcx) const {
+  return mugen::pcx::internal::unwrap(try_parse(pcx));
+}
+
+template <mugen::pcx::MugenVersion Version>
+template <std::size_t Extent>
+MPCXPARSER_INLINE mugen::pcx::Pcx mugen::pcx::PcxParser<Version>::parse(std::span<std::uint8_t, Extent> mem) const {
+  return mugen::pcx::internal::unwrap(try_parse(mem));
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::Pcx mugen::pcx::PcxParser<Version>::parse(const std::uint8_t* mem, std::size_t length) const {
+  return mugen::pcx::internal::unwrap(try_parse(mem, length));
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::Pcx mugen::pcx::PcxParser<Version>::parse(const std::filesystem::path& pcx, const PcxRegion& region) const {
+  mugen::pcx::internal::validate_file(pcx);
+  auto ifs = std::ifstream{pcx, std::ios_base::binary};
+  mugen::pcx::internal::StreamReader reader{ifs};
+  return mugen::pcx::internal::parse_pcx_region<Version>(reader, region, options_, [&]() {
+    // ifs はこの関数内でのみ使用するため、reader の読み出し位置とずれても問題ない
+    ifs.clear();
+    ifs.seekg(0);
+    return *mugen::pcx::internal::read_tail_pallete<Version>(ifs).pallete;
+  });
+}
+
+template <mugen::pcx::MugenVersion Version>
+template <std::size_t Extent>
+MPCXPARSER_INLINE mugen::pcx::Pcx mugen::pcx::PcxParser<Version>::parse(std::span<std::uint8_t, Extent> mem, const PcxRegion& region) const {
+  return parse(mem.data(), mem.size(), region);
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::Pcx mugen::pcx::PcxParser<Version>::parse(const std::uint8_t* mem, std::size_t length, const PcxRegion& region) const {
+  mugen::pcx::internal::MemoryReader reader{mem, length};
+  return mugen::pcx::internal::parse_pcx_region<Version>(reader, region, options_,
+                                                [&]() { return *mugen::pcx::internal::read_tail_pallete<Version>(mem, length).pallete; });
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE void mugen::pcx::PcxParser<Version>::parse_rows(const std::filesystem::path& pcx, const std::function<void(const PcxRow&)>& onRow) const {
+  mugen::pcx::internal::validate_file(pcx);
+  auto ifs = std::ifstream{pcx, std::ios_base::binary};
+
+  // reader が読み出しを始める前に、パレットを末尾から読み出しておく
+  auto pallete = mugen::pcx::internal::read_tail_pallete<Version>(ifs);
+  mugen::pcx::internal::StreamReader reader{ifs};
+  mugen::pcx::internal::parse_pcx_rows<Version>(reader, options_, [&]() { return *pallete.pallete; }, onRow);
+}
+
+template <mugen::pcx::MugenVersion Version>
+template <std::size_t Extent>
+MPCXPARSER_INLINE void mugen::pcx::PcxParser<Version>::parse_rows(std::span<std::uint8_t, Extent> mem,
+                                                            const std::function<void(const PcxRow&)>& onRow) const {
+  parse_rows(mem.data(), mem.size(), onRow);
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE void mugen::pcx::PcxParser<Version>::parse_rows(const std::uint8_t* mem,
+                                                            std::size_t length,
+                                                            const std::function<void(const PcxRow&)>& onRow) const {
+  mugen::pcx::internal::MemoryReader reader{mem, length};
+  mugen::pcx::internal::parse_pcx_rows<Version>(
+      reader, options_, [&]() { return *mugen::pcx::internal::read_tail_pallete<Version>(mem, length).pallete; }, onRow);
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::PcxInfo mugen::pcx::PcxParser<Version>::probe(std::istream& is) const {
+  return mugen::pcx::internal::to_info(mugen::pcx::internal::peek_header<Version>(is));
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::PcxInfo mugen::pcx::PcxParser<Version>::probe(const std::filesystem::path& pcx) const {
+  mugen::pcx::internal::validate_file(pcx);
+  auto ifs = std::ifstream{pcx, std::ios_base::binary};
+  return mugen::pcx::internal::to_info(mugen::pcx::internal::peek_header<Version>(ifs));
+}
+
+template <mugen::pcx::MugenVersion Version>
+template <std::size_t Extent>
+MPCXPARSER_INLINE mugen::pcx::PcxInfo mugen::pcx::PcxParser<Version>::probe(std::span<std::uint8_t, Extent> mem) const {
+  mugen::pcx::internal::MemoryReader reader{mem.data(), mem.size()};
+  return mugen::pcx::internal::to_info(mugen::pcx::internal::read_header<Version>(reader));
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::PcxInfo mugen::pcx::PcxParser<Version>::probe(const std::uint8_t* mem, std::size_t length) const {
+  mugen::pcx::internal::MemoryReader reader{mem, length};
+  return mugen::pcx::internal::to_info(mugen::pcx::internal::read_header<Version>(reader));
+}
+
+template <mugen::pcx::MugenVersion Version>
+template <std::size_t Extent>
+MPCXPARSER_INLINE mugen::pcx::PcxInfo mugen::pcx::PcxParser<Version>::parse_into(std::span<std::uint8_t, Extent> mem, const PcxBuffers& buffers) const {
+  mugen::pcx::internal::MemoryReader reader{mem.data(), mem.size()};
+  return mugen::pcx::internal::parse_pcx_into<Version>(reader, buffers);
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::PcxInfo mugen::pcx::PcxParser<Version>::parse_into(const std::uint8_t* mem,
+                                                                           std::size_t length,
+                                                                           const PcxBuffers& buffers) const {
+  mugen::pcx::internal::MemoryReader reader{mem, length};
+  return mugen::pcx::internal::parse_pcx_into<Version>(reader, buffers);
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::PcxPalleteInfo mugen::pcx::PcxParser<Version>::read_pallete(std::istream& is) const {
+  return mugen::pcx::internal::read_tail_pallete<Version>(is);
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::PcxPalleteInfo mugen::pcx::PcxParser<Version>::read_pallete(const std::filesystem::path& pcx) const {
+  mugen::pcx::internal::validate_file(pcx);
+  auto ifs = std::ifstream{pcx, std::ios_base::binary};
+  return mugen::pcx::internal::read_tail_pallete<Version>(ifs);
+}
+
+template <mugen::pcx::MugenVersion Version>
+template <std::size_t Extent>
+MPCXPARSER_INLINE mugen::pcx::PcxPalleteInfo mugen::pcx::PcxParser<Version>::read_pallete(std::span<std::uint8_t, Extent> mem) const {
+  return mugen::pcx::internal::read_tail_pallete<Version>(mem.data(), mem.size());
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::PcxPalleteInfo mugen::pcx::PcxParser<Version>::read_pallete(const std::uint8_t* mem, std::size_t length) const {
+  return mugen::pcx::internal::read_tail_pallete<Version>(mem, length);
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::PcxDecoder<Version>::PcxDecoder(RowCallback onRow)
+    : onRow_{std::move(onRow)},
+      state_{State::Header},
+      header_{},
+      headerSize_{0},
+      info_{},
+      y_{0},
+      x_{0},
+      hasPendingRun_{false},
+      pendingLength_{0},
+      line_{},
+      row_{},
+      tail_{},
+      tailSize_{0},
+      pallete_{.pallete = std::nullopt, .isEga = false} {}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE void mugen::pcx::PcxDecoder<Version>::begin_body() {
+  state_ = State::Body;
+
+  auto bytes = info_->bytesPerLine * info_->colorPlanes;
+  if (info_->colorPlanes == 1) {
+    // parse と同じく、行末をはみ出したランは width までを書き込み、書き込まれなかった部分は 0xFF とする
+    line_.assign(std::max(info_->width, bytes + 0x3F), 0xFF);
+  } else {
+    line_.assign(bytes + 0x3F, 0);
+    row_.resize(info_->width);
+  }
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE void mugen::pcx::PcxDecoder<Version>::finish_row() {
+  if (info_->colorPlanes == 1) {
+    onRow_(y_, std::span<const std::uint8_t>{line_.data(), info_->width}, {});
+    std::fill(line_.begin(), line_.end(), 0xFF);
+  } else {
+    std::fill(row_.begin(), row_.end(), Pcx::Pixel{});
+    internal::interleave_line(internal::simd::kernels(), line_.data(), x_, info_->width, info_->bytesPerLine, 0, info_->width, row_.data());
+    onRow_(y_, {}, row_);
+  }
+
+  x_ = 0;
+  hasPendingRun_ = false;
+  if (++y_ == info_->height) {
+    state_ = info_->colorPlanes == 1 ? State::Pallete : State::Done;
+  }
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE const std::uint8_t* mugen::pcx::PcxDecoder<Version>::feed_header(const std::uint8_t* p, const std::uint8_t* end) {
+  auto n = std::min<std::size_t>(end - p, sizeof(internal::PcxHeader) - headerSize_);
+  if (headerSize_ < sizeof(header_)) {
+    auto copied = std::min(n, sizeof(header_) - headerSize_);
+    std::memcpy(std::bit_cast<std::uint8_t*>(&header_) + headerSize_, p, copied);
+    if (headerSize_ + copied == sizeof(header_)) {
+      internal::validate_header<Version>(header_);
+      info_ = internal::to_info(header_);
+    }
+  }
+  headerSize_ += n;
+  p += n;
+
+  // ヘッダーの直後で終端に達した場合は本体が無いものとして扱うため、続きを受け取るまで待つ
+  if (headerSize_ == sizeof(internal::PcxHeader) && p != end) {
+    begin_body();
+  }
+  return p;
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE const std::uint8_t* mugen::pcx::PcxDecoder<Version>::feed_body(const std::uint8_t* p, const std::uint8_t* end) {
+  static constexpr std::uint8_t LEN_MARKER = 0xC0;
+
+  const auto& kernels = internal::simd::kernels();
+  auto bytes = info_->bytesPerLine * info_->colorPlanes;
+
+  while (state_ == State::Body) {
+    if (x_ >= bytes) {
+      finish_row();
+      continue;
+    }
+    if (p == end) {
+      break;
+    }
+
+    // 前のバイト列の末尾で分断されたランは、値を受け取った時点で展開する
+    if (hasPendingRun_) {
+      kernels.fill_run(line_.data() + x_, *p++, pendingLength_);
+      x_ += pendingLength_;
+      hasPendingRun_ = false;
+      continue;
+    }
+
+    auto literals = kernels.count_literals(p, std::min<std::size_t>(end - p, bytes - x_));
+    if (literals != 0) {
+      std::memcpy(line_.data() + x_, p, literals);
+      p += literals;
+      x_ += literals;
+    } else {
+      pendingLength_ = *p++ & ~LEN_MARKER;
+      hasPendingRun_ = true;
+    }
+  }
+  return p;
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE const std::uint8_t* mugen::pcx::PcxDecoder<Version>::feed_pallete(const std::uint8_t* p, const std::uint8_t* end) noexcept {
+  static constexpr std::uint8_t PAL_MARKER = 0x0C;
+
+  // マーカーより前の 0 は読み飛ばし、0 以外のバイトがあった場合は EGA パレットを使用する
+  while (tailSize_ == 0 && p != end) {
+    auto markerByte = *p++;
+    if (markerByte == PAL_MARKER) {
+      tail_.marker = markerByte;
+      tailSize_ = 1;
+    } else if (markerByte != 0) {
+      pallete_ = internal::to_pallete_info(header_, nullptr);
+      state_ = State::Done;
+      return p;
+    }
+  }
+
+  auto n = std::min<std::size_t>(end - p, sizeof(tail_) - tailSize_);
+  std::memcpy(std::bit_cast<std::uint8_t*>(&tail_) + tailSize_, p, n);
+  tailSize_ += n;
+  p += n;
+
+  if (tailSize_ == sizeof(tail_)) {
+    pallete_ = internal::to_pallete_info(header_, &tail_);
+    state_ = State::Done;
+  }
+  return p;
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE void mugen::pcx::PcxDecoder<Version>::feed(std::span<const std::uint8_t> chunk) {
+  const auto* p = chunk.data();
+  const auto* end = p + chunk.size();
+
+  while (p != end) {
+    switch (state_) {
+      case State::Header:
+        p = feed_header(p, end);
+        break;
+      case State::Body:
+        p = feed_body(p, end);
+        break;
+      case State::Pallete:
+        p = feed_pallete(p, end);
+        break;
+      case State::Done:
+        return;
+    }
+  }
+}
+
+template <mugen::pcx::MugenVersion Version>
+MPCXPARSER_INLINE mugen::pcx::PcxPalleteInfo mugen::pcx::PcxDecoder<Version>::finish() {
+  if (state_ == State::Header) {
+    if (headerSize_ < sizeof(header_)) {
+      internal::throw_error(ErrorCode::IllegalFormatError);
+    }
+
+    // ヘッダーしかない場合は parse と同じく、EGA パレットと 0xFF のインデックスを持つものとして扱う
+    line_.assign(info_->width, 0xFF);
+    for (; y_ < info_->height; ++y_) {
+      onRow_(y_, line_, {});
+    }
+    pallete_ = PcxPalleteInfo{.pallete = internal::convert_ega_to_pixel(header_.pallete), .isEga = true};
+    state_ = State::Done;
+  }
+
+  if (state_ == State::Body) {
+    auto bytes = info_->bytesPerLine * info_->colorPlanes;
+    const auto& kernels = internal::simd::kernels();
+
+    while (state_ == State::Body) {
+      // 24bit 形式では、終端で分断されたランは値が 0xFF のランとして、以降は長さ 1 の 0xFF のランが続くものとして扱う
+      // パレット形式では、終端で分断されたランは書き込まない
+      if (info_->colorPlanes != 1 && x_ < bytes) {
+        auto len = hasPendingRun_ ? pendingLength_ : 1;
+        kernels.fill_run(line_.data() + x_, 0xFF, len);
+        x_ += len;
+        if (x_ < bytes) {
+          kernels.fill_run(line_.data() + x_, 0xFF, bytes - x_);
+          x_ = bytes;
+        }
+      }
+      finish_row();
+    }
+  }
+
+  if (state_ == State::Pallete) {
+    if (tailSize_ != 0) {
+      std::memset(std::bit_cast<std::uint8_t*>(&tail_) + tailSize_, 0xFF, sizeof(tail_) - tailSize_);
+      pallete_ = internal::to_pallete_info(header_, &tail_);
+    } else {
+      pallete_ = internal::to_pallete_info(header_, nullptr);
+    }
+    state_ = State::Done;
+  }
+
+  return pallete_;
 }
 
 #ifndef MPCXPARSER_HEADER_ONLY
 template class mugen::pcx::PcxParser<mugen::pcx::MugenVersion::Win>;
+template class mugen::pcx::PcxDecoder<mugen::pcx::MugenVersion::Win>;
 template mugen::pcx::Pcx mugen::pcx::PcxParserWin::parse<std::dynamic_extent>(std::span<std::uint8_t, std::dynamic_extent> mem) const;
+template mugen::pcx::ParseResult mugen::pcx::PcxParserWin::try_parse<std::dynamic_extent>(std::span<std::uint8_t, std::dynamic_extent> mem) const;
+template mugen::pcx::Pcx mugen::pcx::PcxParserWin::parse<std::dynamic_extent>(std::span<std::uint8_t, std::dynamic_extent> mem,
+                                                                               const PcxRegion& region) const;
+template void mugen::pcx::PcxParserWin::parse_rows<std::dynamic_extent>(std::span<std::uint8_t, std::dynamic_extent> mem,
+                                                                        const std::function<void(const PcxRow&)>& onRow) const;
+template mugen::pcx::PcxInfo mugen::pcx::PcxParserWin::probe<std::dynamic_extent>(std::span<std::uint8_t, std::dynamic_extent> mem) const;
+template mugen::pcx::PcxInfo mugen::pcx::PcxParserWin::parse_into<std::dynamic_extent>(std::span<std::uint8_t, std::dynamic_extent> mem,
+                                                                                       const PcxBuffers& buffers) const;
+template mugen::pcx::PcxPalleteInfo mugen::pcx::PcxParserWin::read_pallete<std::dynamic_extent>(std::span<std::uint8_t, std::dynamic_extent> mem) const;
 #endif
@@ -26,9 +26,10 @@
 #endif
 
 #include "mpcxparser/mpcxparser.h"
+#include "mpcxparser/impl/simd.hpp"
 
 #include <bit>
-#include <bitset>
+#include <cstring>
 #include <fstream>
 #include <ios>
 #include <memory>
@@ -37,7 +38,6 @@ namespace mugen {
 namespace pcx {
 namespace internal {
 
-static constexpr std::uint8_t LEN_MARKER = 0xC0;
 static constexpr std::uint8_t PAL_MARKER = 0x0C;
 
 MPCXPARSER_PACK(struct IcoHeader {
@@ -99,88 +99,195 @@ MPCXPARSER_PACK(struct BmpV4InfoHeader {
   std::uint32_t gammaB;
 });
 
-MPCXPARSER_PACK(struct PcxRGB {
-  std::uint8_t red;
-  std::uint8_t green;
-  std::uint8_t blue;
-});
+// 細かな書き込みを作業領域にまとめ、大きな単位で os に出力する
+// 出力し終えたら flush() を呼び出す
+class StreamWriter {
+  static constexpr std::size_t CAPACITY = 0x10000;
 
-MPCXPARSER_PACK(struct PcxPallete {
-  std::uint8_t marker;
-  PcxRGB pal[256];
-});
+  std::ostream& os_;
+  std::unique_ptr<char[]> buffer_;
+  std::size_t size_;
 
-static inline std::uint8_t getc(std::vector<std::uint8_t>::const_iterator& begin, std::vector<std::uint8_t>::const_iterator& end) noexcept {
-  if (begin == end) {
-    return 0xFF;
-  } else {
-    auto result = *begin;
-    ++begin;
-    return result;
+ public:
+  inline explicit StreamWriter(std::ostream& os) : os_{os}, buffer_{new char[CAPACITY]}, size_{0} {}
+
+  StreamWriter(const StreamWriter&) = delete;
+  StreamWriter& operator=(const StreamWriter&) = delete;
+
+  inline void write(const void* data, std::size_t n) {
+    if (size_ + n > CAPACITY) {
+      flush();
+      // 作業領域に収まらない場合はそのまま出力する
+      if (n >= CAPACITY) {
+        os_.write(static_cast<const char*>(data), static_cast<std::streamsize>(n));
+        return;
+      }
+    }
+    std::memcpy(buffer_.get() + size_, data, n);
+    size_ += n;
   }
-}
 
-static inline void pcx_encode(std::vector<std::uint8_t>::const_iterator& begin,
-                              std::vector<std::uint8_t>::const_iterator& end,
-                              std::size_t maxLength,
-                              std::size_t& length,
-                              std::uint8_t& value) noexcept {
-  if (begin == end) {
-    length = 0;
-    return;
+  inline void put(std::uint8_t c) {
+    if (size_ == CAPACITY) {
+      flush();
+    }
+    buffer_[size_++] = static_cast<char>(c);
   }
 
-  if (maxLength > 0x3F) {
-    maxLength = 0x3F;
+  inline void flush() {
+    if (size_ != 0) {
+      os_.write(buffer_.get(), static_cast<std::streamsize>(size_));
+      size_ = 0;
+    }
+  }
+};
+
+// 出力を std::vector の末尾に追加する
+class VectorWriter {
+  std::vector<std::uint8_t>& buffer_;
+
+ public:
+  inline explicit VectorWriter(std::vector<std::uint8_t>& buffer) noexcept : buffer_{buffer} {}
+
+  inline void write(const void* data, std::size_t n) {
+    auto size = buffer_.size();
+    buffer_.resize(size + n);
+    std::memcpy(buffer_.data() + size, data, n);
   }
 
-  length = 1;
-  value = getc(begin, end);
+  inline void put(std::uint8_t c) { buffer_.push_back(c); }
+};
+
+// 出力を呼び出し元のバッファに書き込む
+// バッファが不足した場合は std::invalid_argument を送出する
+class SpanWriter {
+  std::span<std::uint8_t> dest_;
+  std::size_t size_;
 
-  while (begin != end && length < maxLength) {
-    auto next = getc(begin, end);
-    if (next != value) {
-      --begin;
-      break;
+  inline void reserve(std::size_t n) const {
+    if (dest_.size() - size_ < n) {
+      raise<std::invalid_argument>("The given buffer is too small for the output.");
     }
-    ++length;
   }
-}
 
-static inline void write_as_pcx8(std::ostream& os,
-                                 const PcxHeader& header,
-                                 const std::array<Pcx::Pixel, 256>& pallete,
-                                 const std::vector<std::uint8_t>& indexes,
-                                 bool outputPalleteData) {
-  os.write(std::bit_cast<char*>(&header), sizeof(header));
+ public:
+  inline explicit SpanWriter(std::span<std::uint8_t> dest) noexcept : dest_{dest}, size_{0} {}
 
-  std::size_t maxLength = 0;
+  inline void write(const void* data, std::size_t n) {
+    reserve(n);
+    std::memcpy(dest_.data() + size_, data, n);
+    size_ += n;
+  }
+
+  inline void put(std::uint8_t c) {
+    reserve(1);
+    dest_[size_++] = c;
+  }
+
+  // 書き込んだバイト数
+  inline std::size_t size() const noexcept { return size_; }
+};
 
-  auto begin = indexes.cbegin();
-  auto end = indexes.cend();
-  while (begin != end) {
-    std::size_t len;
-    std::uint8_t value;
+// len バイトの value のランを出力する
+template <class Writer>
+static inline void write_run(Writer& out, std::size_t len, std::uint8_t value) {
+  for (; len > 0x3F * 2; len -= 0x3F) {
+    out.put(0xFF);
+    out.put(value);
+  }
+
+  std::uint8_t token[4];
+  out.write(token, static_cast<std::size_t>(simd::put_runs(token, len, value) - token));
+}
 
-    if (maxLength == 0) {
-      maxLength = std::min<std::size_t>(header.hRes, header.bytesPerLine);
+// 1 行の長さ（bytesPerLine）が 0 のヘッダーで出力する場合の符号化
+// 先頭の 1 バイトだけを単独で出力し、以降は行をまたいでランを続ける
+// 入力を 1 行ずつ受け取り、末尾のランは次の行へ持ち越す
+template <class Writer>
+class UnboundedRleWriter {
+  Writer& out_;
+  std::vector<std::uint8_t> buffer_;
+
+  bool first_;
+  std::uint8_t value_;
+  std::size_t length_;
+
+ public:
+  // lineSize は 1 回に受け取る最大のバイト数
+  inline UnboundedRleWriter(Writer& out, std::size_t lineSize) : out_{out}, buffer_(lineSize * 2), first_{true}, value_{0}, length_{0} {}
+
+  inline void write(const std::uint8_t* src, std::size_t n) {
+    if (n > 0 && first_) {
+      write_run(out_, 1, src[0]);
+      first_ = false;
+      ++src;
+      --n;
     }
-    internal::pcx_encode(begin, end, maxLength, len, value);
-    maxLength -= len;
-
-    if (len <= 2 && value < LEN_MARKER) {
-      if (len == 1) {
-        os.write(std::bit_cast<char*>(&value), 1);
-      } else {
-        char buf[] = {static_cast<char>(value), static_cast<char>(value)};
-        os.write(buf, 2);
+
+    // 持ち越したランの続き
+    std::size_t i = 0;
+    if (length_ > 0) {
+      for (; i < n && src[i] == value_; ++i) {
+      }
+      length_ += i;
+      if (i == n) {
+        return;
       }
-    } else {
-      char buf[] = {static_cast<char>(len | LEN_MARKER), static_cast<char>(value)};
-      os.write(buf, 2);
+      write_run(out_, length_, value_);
+      length_ = 0;
+    }
+    if (i == n) {
+      return;
+    }
+
+    // 末尾のランは次の行の先頭と続く場合があるため持ち越す
+    auto last = n - 1;
+    for (; last > i && src[last - 1] == src[n - 1]; --last) {
+    }
+    out_.write(buffer_.data(), simd::kernels().encode_rle(src + i, last - i, buffer_.data()));
+    value_ = src[n - 1];
+    length_ = n - last;
+  }
+
+  inline void finish() {
+    if (length_ > 0) {
+      write_run(out_, length_, value_);
+      length_ = 0;
+    }
+  }
+};
+
+// src を lineLength バイトごとに区切ってランレングスで出力する（ランは区切りをまたがない）
+// lineLength が 0 の場合は UnboundedRleWriter で width バイトずつ出力する
+template <class Writer>
+static inline void write_rle(Writer& out, const std::uint8_t* src, std::size_t n, std::size_t lineLength, std::size_t width) {
+  if (lineLength == 0) {
+    width = std::max<std::size_t>(width, 1);
+    UnboundedRleWriter<Writer> writer{out, std::min(width, n)};
+    for (std::size_t i = 0; i < n; i += width) {
+      writer.write(src + i, std::min(width, n - i));
     }
+    writer.finish();
+    return;
   }
 
+  // 1 バイトは高々 2 バイトに符号化される
+  auto encode_rle = simd::kernels().encode_rle;
+  auto buffer = std::vector<std::uint8_t>(std::min(lineLength, n) * 2);
+  for (std::size_t i = 0; i < n; i += lineLength) {
+    out.write(buffer.data(), encode_rle(src + i, std::min(lineLength, n - i), buffer.data()));
+  }
+}
+
+template <class Writer>
+static inline void write_as_pcx8(Writer& out,
+                                 const PcxHeader& header,
+                                 const std::array<Pcx::Pixel, 256>& pallete,
+                                 const std::vector<std::uint8_t>& indexes,
+                                 bool outputPalleteData) {
+  out.write(&header, sizeof(header));
+  write_rle(out, indexes.data(), indexes.size(), std::min<std::size_t>(header.hRes, header.bytesPerLine), header.hRes);
+
   if (outputPalleteData) {
     internal::PcxPallete pcxPallete{.marker = PAL_MARKER};
     for (std::size_t i = 0; i < pallete.size(); ++i) {
@@ -188,53 +295,62 @@ static inline void write_as_pcx8(std::ostream& os,
       pcxPallete.pal[i].green = pallete[i].green;
       pcxPallete.pal[i].blue = pallete[i].blue;
     }
-    os.write(std::bit_cast<char*>(&pcxPallete), sizeof(pcxPallete));
+    out.write(&pcxPallete, sizeof(pcxPallete));
   } else {
-    os.write(std::bit_cast<char*>(&PAL_MARKER), 1);
+    out.put(PAL_MARKER);
   }
 }
 
-static inline void write_as_pcx32(std::ostream& os, const PcxHeader& header, const std::vector<Pcx::Pixel>& data) {
-  os.write(std::bit_cast<char*>(&header), sizeof(header));
+// 1 行ずつ R/G/B の各プレーンに分けてから符号化する
+template <class Writer>
+static inline void write_as_pcx32(Writer& out, const PcxHeader& header, const std::vector<Pcx::Pixel>& data) {
+  out.write(&header, sizeof(header));
 
-  std::size_t maxLength = 0;
+  std::size_t width = header.hRes;
+  std::size_t lineBytes = width * 3;
+  std::size_t segment = std::min<std::size_t>(width, header.bytesPerLine) * 3;
+  if (lineBytes == 0) {
+    return;
+  }
 
-  auto pcxData = std::vector<std::uint8_t>(header.hRes * header.vRes * 3);
-  for (std::size_t y = 0; y < header.vRes; ++y) {
-    for (std::size_t x = 0; x < header.hRes; ++x) {
-      pcxData[y * header.hRes * 3 + x + 0 * header.hRes] = data[y * header.hRes + x].red;
-      pcxData[y * header.hRes * 3 + x + 1 * header.hRes] = data[y * header.hRes + x].green;
-      pcxData[y * header.hRes * 3 + x + 2 * header.hRes] = data[y * header.hRes + x].blue;
+  const auto& kernels = simd::kernels();
+  if (segment == 0) {
+    auto line = std::vector<std::uint8_t>(lineBytes);
+    UnboundedRleWriter<Writer> writer{out, lineBytes};
+    for (std::size_t y = 0; y < header.vRes; ++y) {
+      kernels.deinterleave_rgb(std::bit_cast<const std::uint8_t*>(data.data() + y * width), line.data(), line.data() + width, line.data() + width * 2, width);
+      writer.write(line.data(), lineBytes);
     }
+    writer.finish();
+    return;
   }
 
-  auto begin = pcxData.cbegin();
-  auto end = pcxData.cend();
-  while (begin != end) {
-    std::size_t len;
-    std::uint8_t value;
+  // bytesPerLine が hRes より小さい場合は区切りが行の途中になるため、区切りに満たない分を次の行へ持ち越す
+  auto line = std::vector<std::uint8_t>(lineBytes + segment);
+  auto encoded = std::vector<std::uint8_t>(segment * 2);
+  std::size_t pending = 0;
 
-    if (maxLength == 0) {
-      maxLength = std::min<std::size_t>(header.hRes, header.bytesPerLine) * 3;
-    }
-    internal::pcx_encode(begin, end, maxLength, len, value);
-    maxLength -= len;
-
-    if (len <= 2 && value < LEN_MARKER) {
-      if (len == 1) {
-        os.write(std::bit_cast<char*>(&value), 1);
-      } else {
-        char buf[] = {static_cast<char>(value), static_cast<char>(value)};
-        os.write(buf, 2);
-      }
-    } else {
-      char buf[] = {static_cast<char>(len | LEN_MARKER), static_cast<char>(value)};
-      os.write(buf, 2);
+  for (std::size_t y = 0; y < header.vRes; ++y) {
+    auto* red = line.data() + pending;
+    kernels.deinterleave_rgb(std::bit_cast<const std::uint8_t*>(data.data() + y * width), red, red + width, red + width * 2, width);
+
+    std::size_t n = pending + lineBytes;
+    std::size_t i = 0;
+    for (; i + segment <= n; i += segment) {
+      out.write(encoded.data(), kernels.encode_rle(line.data() + i, segment, encoded.data()));
     }
+
+    pending = n - i;
+    std::memmove(line.data(), line.data() + i, pending);
+  }
+
+  if (pending > 0) {
+    out.write(encoded.data(), kernels.encode_rle(line.data(), pending, encoded.data()));
   }
 }
 
-static inline void write_as_ico8(std::ostream& os,
+template <class Writer>
+static inline void write_as_ico8(Writer& out,
                                  std::size_t width,
                                  std::size_t height,
                                  const std::array<Pcx::Pixel, 256>& pallete,
@@ -255,7 +371,7 @@ static inline void write_as_ico8(std::ostream& os,
   std::size_t sizeOfAndMask = (width + 7) / 8;
   // 2. マスクを4Byteにアライメント調整
   sizeOfAndMask = (sizeOfAndMask + 3) & (~3);
-  std::size_t lineSizeOfAndMask = sizeOfAndMask * 8;
+  std::size_t lineSizeOfAndMask = sizeOfAndMask;
   // 3. ANDマスクのサイズ = 一行に必要なバイト数 * height
   sizeOfAndMask *= height;
 
@@ -280,41 +396,68 @@ static inline void write_as_ico8(std::ostream& os,
       .palleteColors = 256,
   };
 
-  os.write(std::bit_cast<char*>(&icoHeader), sizeof(icoHeader));
-  os.write(std::bit_cast<char*>(&bmpHeader), sizeof(bmpHeader));
+  out.write(&icoHeader, sizeof(icoHeader));
+  out.write(&bmpHeader, sizeof(bmpHeader));
 
+  std::uint8_t BGR_[256][4];
   for (std::size_t i = 0; i < 256; ++i) {
-    char BGR_[] = {static_cast<char>(pallete[i].blue), static_cast<char>(pallete[i].green), static_cast<char>(pallete[i].red), 0};
-    os.write(BGR_, 4);
+    BGR_[i][0] = pallete[i].blue;
+    BGR_[i][1] = pallete[i].green;
+    BGR_[i][2] = pallete[i].red;
+    BGR_[i][3] = 0;
   }
+  out.write(BGR_, sizeof(BGR_));
 
-  auto andMask = std::unique_ptr<char[]>(new char[sizeOfAndMask]());
-  auto line = std::unique_ptr<char[]>(new char[lineSizeOfXorMask]());
+  // 0番目の色を使用しているピクセルを透過
+  // indexesの並びとandMaskの並びではyが逆順であることに注意
+  auto mask_zero = simd::kernels().mask_zero;
+  auto andMask = std::unique_ptr<std::uint8_t[]>(new std::uint8_t[sizeOfAndMask]());
+  auto line = std::unique_ptr<std::uint8_t[]>(new std::uint8_t[lineSizeOfXorMask]());
   for (std::size_t y = height - 1; y < height; --y) {
-    for (std::size_t x = 0; x < width; ++x) {
-      // 0番目の色を使用しているピクセルを透過
-      if ((line[x] = indexes[y * width + x]) == 0) {
-        // indexesの並びとandMaskの並びではyが逆順であることに注意して
-        // indexをandMaskにおけるindexを計算
-        std::size_t index = ((height - 1) - y) * lineSizeOfAndMask + x;
-
-        // bit単位で値を書き換えるため、char -> bitsetに変更
-        // indexはビット単位なので、index / 8でバイト単位のindexを算出
-        std::bitset<8> maskBits{static_cast<unsigned long>(andMask[index / 8])};
-
-        // 1バイト単位でbitsetにしているため、0-7のindexでビット単位の値を書き換え
-        // bitset -> char はリトルエンディアンであることに注意
-        maskBits[7 - index % 8] = 1;
-        andMask[index / 8] = static_cast<char>(maskBits.to_ulong());
-      }
-    }
-    os.write(line.get(), lineSizeOfXorMask);
+    const auto* row = indexes.data() + y * width;
+    std::memcpy(line.get(), row, width);
+    mask_zero(row, andMask.get() + ((height - 1) - y) * lineSizeOfAndMask, width);
+    out.write(line.get(), lineSizeOfXorMask);
+  }
+
+  out.write(andMask.get(), sizeOfAndMask);
+}
+
+// y 行目から rows 行分を format の並びで dest に書き込む
+// パレット形式の場合は lut（pack_pallete で変換したパレット）を引き、そうでなければ data() を並べ替える
+static inline void pack_lines(const Pcx& pcx, PixelFormat format, const std::array<std::uint32_t, 256>& lut, std::size_t y, std::size_t rows, std::uint32_t* dest) {
+  const auto& kernels = simd::kernels();
+
+  auto offset = y * pcx.width();
+  auto n = rows * pcx.width();
+  if (pcx.pallete() && pcx.indexes()) {
+    kernels.lookup(pcx.indexes()->data() + offset, lut.data(), std::bit_cast<std::uint8_t*>(dest), n);
+  } else {
+    kernels.swizzle(std::bit_cast<const std::uint8_t*>(pcx.data().data() + offset), std::bit_cast<std::uint8_t*>(dest), n, format);
   }
+}
+
+static inline std::array<std::uint32_t, 256> pack_pallete(const Pcx& pcx, PixelFormat format) noexcept {
+  return pcx.pallete() ? simd::pack_pallete(*pcx.pallete(), format) : std::array<std::uint32_t, 256>{};
+}
+
+// 下の行から順に、BGRA の並びで 1 行ずつまとめて出力する
+template <class Writer>
+static inline void write_bgra_lines(Writer& out, const Pcx& pcx) {
+  auto lut = pack_pallete(pcx, PixelFormat::BGRA8888);
 
-  os.write(std::bit_cast<char*>(andMask.get()), sizeOfAndMask);
+  std::vector<std::uint32_t> line(pcx.width());
+  for (std::size_t y = pcx.height() - 1; y < pcx.height(); --y) {
+    pack_lines(pcx, PixelFormat::BGRA8888, lut, y, 1, line.data());
+    out.write(line.data(), line.size() * 4);
+  }
 }
 
-static inline void write_as_ico32(std::ostream& os, std::size_t width, std::size_t height, std::vector<Pcx::Pixel> data) {
+template <class Writer>
+static inline void write_as_ico32(Writer& out, const Pcx& pcx) {
+  auto width = pcx.width();
+  auto height = pcx.height();
+
   // ビットマップ情報のサイズ
   //  = BMPヘッダーサイズ + XORマスクのサイズ（= height * width * 4） + ANDマスクのサイズ
 
@@ -348,114 +491,92 @@ static inline void write_as_ico32(std::ostream& os, std::size_t width, std::size
       .sizeOfImage = static_cast<std::uint32_t>(width * height * 4),
   };
 
-  os.write(std::bit_cast<char*>(&icoHeader), sizeof(icoHeader));
-  os.write(std::bit_cast<char*>(&bmpHeader), sizeof(bmpHeader));
+  out.write(&icoHeader, sizeof(icoHeader));
+  out.write(&bmpHeader, sizeof(bmpHeader));
 
-  for (std::size_t y = height - 1; y < height; --y) {
-    for (std::size_t x = 0; x < width; ++x) {
-      const auto& pixel = data[y * width + x];
-
-      char BGRA[] = {static_cast<char>(pixel.blue), static_cast<char>(pixel.green), static_cast<char>(pixel.red), static_cast<char>(pixel.alpha)};
-      os.write(BGRA, 4);
-    }
-  }
+  write_bgra_lines(out, pcx);
 
   auto andMask = std::unique_ptr<char[]>(new char[sizeOfAndMask]());
-  os.write(andMask.get(), sizeOfAndMask);
+  out.write(andMask.get(), sizeOfAndMask);
 }
 
-};  // namespace internal
-};  // namespace pcx
-};  // namespace mugen
+// ==== Formats ====
 
-MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_pcx(const std::filesystem::path& path) const {
-  std::ofstream ofs{path, std::ios_base::binary};
-  write_as_pcx(ofs);
-}
-
-MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_pcx(std::ostream& os) const {
+static inline PcxHeader make_pcx_header(const Pcx& pcx) noexcept {
   static constexpr std::uint8_t PCX_SIGNATURE = 0x0A;
 
-  internal::PcxHeader header{
+  return PcxHeader{
       .signature = PCX_SIGNATURE,
       .version = 5,
       .encoding = 1,
       .bitsPerPixel = 8,
-      .endX = static_cast<std::uint16_t>(width_ - 1),
-      .endY = static_cast<std::uint16_t>(height_ - 1),
-      .hRes = static_cast<std::uint16_t>(width_),
-      .vRes = static_cast<std::uint16_t>(height_),
-      .bytesPerLine = static_cast<std::uint16_t>(bytesPerLine_),
+      .endX = static_cast<std::uint16_t>(pcx.width() - 1),
+      .endY = static_cast<std::uint16_t>(pcx.height() - 1),
+      .hRes = static_cast<std::uint16_t>(pcx.width()),
+      .vRes = static_cast<std::uint16_t>(pcx.height()),
+      .colorPlanes = static_cast<std::uint8_t>(pcx.pallete() && pcx.indexes() ? 1 : 3),
+      .bytesPerLine = static_cast<std::uint16_t>(pcx.bytes_per_line()),
       .palleteMode = 1,
   };
-
-  if (pallete_ && indexes_) {
-    header.colorPlanes = 1;
-    internal::write_as_pcx8(os, header, *pallete_, *indexes_, true);
-  } else {
-    header.colorPlanes = 3;
-    internal::write_as_pcx32(os, header, data_);
-  }
 }
 
-MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_pcx_without_pallete(const std::filesystem::path& path) const {
-  std::ofstream ofs{path, std::ios_base::binary};
-  write_as_pcx_without_pallete(ofs);
+// pcx形式で出力した場合の最大のバイト数（全てのバイトが 2 バイトに符号化される場合）
+static inline std::size_t pcx_size_bound(const Pcx& pcx, bool outputPalleteData) noexcept {
+  auto header = make_pcx_header(pcx);
+  auto bytes = std::min<std::size_t>(header.hRes, header.bytesPerLine) * header.colorPlanes * header.vRes;
+  return sizeof(PcxHeader) + bytes * 2 + (header.colorPlanes == 1 && outputPalleteData ? sizeof(PcxPallete) : 1);
 }
 
-MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_pcx_without_pallete(std::ostream& os) const {
-  static constexpr std::uint8_t PCX_SIGNATURE = 0x0A;
-
-  internal::PcxHeader header{
-      .signature = PCX_SIGNATURE,
-      .version = 5,
-      .encoding = 1,
-      .bitsPerPixel = 8,
-      .endX = static_cast<std::uint16_t>(width_ - 1),
-      .endY = static_cast<std::uint16_t>(height_ - 1),
-      .hRes = static_cast<std::uint16_t>(width_),
-      .vRes = static_cast<std::uint16_t>(height_),
-      .bytesPerLine = static_cast<std::uint16_t>(bytesPerLine_),
-      .palleteMode = 1,
-  };
-
-  if (pallete_ && indexes_) {
-    header.colorPlanes = 1;
-    internal::write_as_pcx8(os, header, *pallete_, *indexes_, false);
+template <class Writer>
+static inline void write_pcx(Writer& out, const Pcx& pcx, bool outputPalleteData) {
+  auto header = make_pcx_header(pcx);
+  if (header.colorPlanes == 1) {
+    write_as_pcx8(out, header, *pcx.pallete(), *pcx.indexes(), outputPalleteData);
   } else {
-    header.colorPlanes = 3;
-    internal::write_as_pcx32(os, header, data_);
+    write_as_pcx32(out, header, pcx.data());
   }
 }
 
-MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_ico(const std::filesystem::path& path) const {
-  std::ofstream ofs{path, std::ios_base::binary};
-  write_as_ico(ofs);
+static inline void validate_ico(const Pcx& pcx) {
+  if (pcx.width() > 256 || pcx.height() > 256) {
+    raise<IllegalFormatError>("The PCX is too large for icon.");
+  }
 }
 
-MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_ico(std::ostream& os) const {
-  if (width_ > 256 || height_ > 256) {
-    throw IllegalFormatError{"The PCX is too large for icon."};
+// パレット情報とインデックス情報を持っている場合、
+// 出力されるファイルサイズがより小さくなる形式で出力
+//
+// width * height * 4 >= width * height + 256 * 4 => ico 8bit index with 256 pallete
+// width * height * 4 < width * height + 256 * 4  => ico 32bit color
+static inline bool is_ico8(const Pcx& pcx) noexcept {
+  return pcx.pallete() && pcx.indexes() && pcx.width() * pcx.height() >= (256 * 4) / 3;
+}
+
+static inline std::size_t ico_size(const Pcx& pcx) noexcept {
+  auto width = pcx.width();
+  auto height = pcx.height();
+  auto sizeOfAndMask = (((width + 7) / 8 + 3) & (~3)) * height;
+  if (is_ico8(pcx)) {
+    return sizeof(IcoHeader) + sizeof(BmpInfoHeader) + 256 * 4 + ((width + 3) & (~3)) * height + sizeOfAndMask;
   }
+  return sizeof(IcoHeader) + sizeof(BmpInfoHeader) + width * height * 4 + sizeOfAndMask;
+}
 
-  // パレット情報とインデックス情報を持っている場合、
-  // 出力されるファイルサイズがより小さくなる形式で出力
-  //
-  // width * height * 4 >= width * height + 256 * 4 => ico 8bit index with 256 pallete
-  // width * height * 4 < width * height + 256 * 4  => ico 32bit color
-  if (pallete_ && indexes_ && width_ * height_ >= (256 * 4) / 3) {
-    internal::write_as_ico8(os, width_, height_, *pallete_, *indexes_);
+template <class Writer>
+static inline void write_ico(Writer& out, const Pcx& pcx) {
+  if (is_ico8(pcx)) {
+    write_as_ico8(out, pcx.width(), pcx.height(), *pcx.pallete(), *pcx.indexes());
   } else {
-    internal::write_as_ico32(os, width_, height_, data_);
+    write_as_ico32(out, pcx);
   }
 }
 
-MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_bmp(const std::filesystem::path& path) const {
-  std::ofstream ofs{path, std::ios_base::binary};
-  write_as_bmp(ofs);
+static inline std::size_t bmp_size(const Pcx& pcx) noexcept {
+  return sizeof(BmpFileHeader) + sizeof(BmpInfoHeader) + pcx.width() * pcx.height() * 4;
 }
 
-MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_bmp(std::ostream& os) const {
+template <class Writer>
+static inline void write_bmp(Writer& out, const Pcx& pcx) {
   static constexpr char BMP_SIGNATURE[2] = {'B', 'M'};
 
   internal::BmpFileHeader fileHeader{
@@ -466,44 +587,37 @@ MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_bmp(std::ostream& os) const {
 
   internal::BmpInfoHeader infoHeader{
       .sizeOfHeader = sizeof(internal::BmpInfoHeader),
-      .width = static_cast<std::uint32_t>(width_),
-      .height = static_cast<std::uint32_t>(height_),
+      .width = static_cast<std::uint32_t>(pcx.width()),
+      .height = static_cast<std::uint32_t>(pcx.height()),
       .planes = 1,
       .colorDepth = 32,
-      .sizeOfImage = static_cast<std::uint32_t>(width_ * height_ * 4),
+      .sizeOfImage = static_cast<std::uint32_t>(pcx.width() * pcx.height() * 4),
   };
 
-  os.write(std::bit_cast<char*>(&fileHeader), sizeof(fileHeader));
-  os.write(std::bit_cast<char*>(&infoHeader), sizeof(infoHeader));
+  out.write(&fileHeader, sizeof(fileHeader));
+  out.write(&infoHeader, sizeof(infoHeader));
 
-  for (std::size_t y = height_ - 1; y < height_; --y) {
-    for (std::size_t x = 0; x < width_; ++x) {
-      const auto& pixel = data_[y * width_ + x];
-
-      char BGRA[] = {static_cast<char>(pixel.blue), static_cast<char>(pixel.green), static_cast<char>(pixel.red), static_cast<char>(pixel.alpha)};
-      os.write(BGRA, 4);
-    }
-  }
+  write_bgra_lines(out, pcx);
 }
 
-MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_abmp(const std::filesystem::path& path) const {
-  std::ofstream ofs{path, std::ios_base::binary};
-  write_as_abmp(ofs);
+static inline std::size_t abmp_size(const Pcx& pcx) noexcept {
+  return sizeof(BmpFileHeader) + sizeof(BmpV4InfoHeader) + pcx.width() * pcx.height() * 4;
 }
 
-MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_abmp(std::ostream& os) const {
+template <class Writer>
+static inline void write_abmp(Writer& out, const Pcx& pcx) {
   static constexpr char BMP_SIGNATURE[2] = {'B', 'M'};
 
   internal::BmpFileHeader fileHeader{
       .signature = {BMP_SIGNATURE[0], BMP_SIGNATURE[1]},
-      .size = static_cast<std::uint32_t>(width_ * height_ * 4 + sizeof(internal::BmpFileHeader) + sizeof(internal::BmpV4InfoHeader)),
+      .size = static_cast<std::uint32_t>(abmp_size(pcx)),
       .offset = sizeof(internal::BmpFileHeader) + sizeof(internal::BmpV4InfoHeader),
   };
 
   internal::BmpV4InfoHeader infoHeader{
       .sizeOfHeader = sizeof(internal::BmpV4InfoHeader),
-      .width = static_cast<std::uint32_t>(width_),
-      .height = static_cast<std::uint32_t>(height_),
+      .width = static_cast<std::uint32_t>(pcx.width()),
+      .height = static_cast<std::uint32_t>(pcx.height()),
       .planes = 1,
       .colorDepth = 32,
       .compressionType = 3,
@@ -513,15 +627,196 @@ MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_abmp(std::ostream& os) const {
       .bitmaskA = 0xFF000000,
   };
 
-  os.write(std::bit_cast<char*>(&fileHeader), sizeof(fileHeader));
-  os.write(std::bit_cast<char*>(&infoHeader), sizeof(infoHeader));
+  out.write(&fileHeader, sizeof(fileHeader));
+  out.write(&infoHeader, sizeof(infoHeader));
+
+  write_bgra_lines(out, pcx);
+}
+
+// ==== Outputs ====
+
+template <class Encode>
+static inline void write_to_stream(std::ostream& os, Encode&& encode) {
+  StreamWriter out{os};
+  encode(out);
+  out.flush();
+}
+
+template <class Encode>
+static inline std::vector<std::uint8_t> encode_to_vector(std::size_t capacity, Encode&& encode) {
+  std::vector<std::uint8_t> buffer;
+  buffer.reserve(capacity);
+  VectorWriter out{buffer};
+  encode(out);
+  return buffer;
+}
+
+template <class Encode>
+static inline std::size_t encode_to_span(std::span<std::uint8_t> dest, Encode&& encode) {
+  SpanWriter out{dest};
+  encode(out);
+  return out.size();
+}
+
+};  // namespace internal
+};  // namespace pcx
+};  // namespace mugen
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::expand_indexes(std::span<const std::uint8_t> indexes,
+                                                       const std::array<Pixel, 256>& pallete,
+                                                       std::span<Pixel> dest) {
+  if (dest.size() < indexes.size()) {
+    internal::raise<std::invalid_argument>("The given buffer is too small for the indexes.");
+  }
+
+  auto lut = internal::simd::pack_pallete(pallete, PixelFormat::RGBA8888);
+  internal::simd::kernels().lookup(indexes.data(), lut.data(), std::bit_cast<std::uint8_t*>(dest.data()), indexes.size());
+}
 
-  for (std::size_t y = height_ - 1; y < height_; --y) {
-    for (std::size_t x = 0; x < width_; ++x) {
-      const auto& pixel = data_[y * width_ + x];
+MPCXPARSER_INLINE std::vector<mugen::pcx::Pcx::Pixel> mugen::pcx::Pcx::data_with(const std::array<Pixel, 256>& pallete) const {
+  if (!indexes_) {
+    return data();
+  }
+
+  std::vector<Pixel> data(indexes_->size());
+  expand_indexes(*indexes_, pallete, data);
+  return data;
+}
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::data_with(const std::array<Pixel, 256>& pallete, std::span<Pixel> dest) const {
+  if (dest.size() < width_ * height_) {
+    internal::raise<std::invalid_argument>("The given buffer is too small for the PCX.");
+  }
+
+  if (indexes_) {
+    expand_indexes(*indexes_, pallete, dest);
+  } else {
+    std::copy(data().cbegin(), data().cend(), dest.begin());
+  }
+}
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::pack(PixelFormat format, std::span<std::uint32_t> dest) const {
+  if (dest.size() < width_ * height_) {
+    internal::raise<std::invalid_argument>("The given buffer is too small for the PCX.");
+  }
+  internal::pack_lines(*this, format, internal::pack_pallete(*this, format), 0, height_, dest.data());
+}
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::pack(PixelFormat format, const std::array<Pixel, 256>& pallete, std::span<std::uint32_t> dest) const {
+  if (dest.size() < width_ * height_) {
+    internal::raise<std::invalid_argument>("The given buffer is too small for the PCX.");
+  }
+  internal::pack_lines(*this, format, internal::simd::pack_pallete(pallete, format), 0, height_, dest.data());
+}
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_pcx(const std::filesystem::path& path) const {
+  std::ofstream ofs{path, std::ios_base::binary};
+  write_as_pcx(ofs);
+}
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_pcx(std::ostream& os) const {
+  internal::write_to_stream(os, [this](auto& out) { internal::write_pcx(out, *this, true); });
+}
+
+MPCXPARSER_INLINE std::vector<std::uint8_t> mugen::pcx::Pcx::encode_as_pcx() const {
+  return internal::encode_to_vector(internal::pcx_size_bound(*this, true), [this](auto& out) { internal::write_pcx(out, *this, true); });
+}
+
+MPCXPARSER_INLINE std::size_t mugen::pcx::Pcx::encode_as_pcx(std::span<std::uint8_t> dest) const {
+  return internal::encode_to_span(dest, [this](auto& out) { internal::write_pcx(out, *this, true); });
+}
 
-      char BGRA[] = {static_cast<char>(pixel.blue), static_cast<char>(pixel.green), static_cast<char>(pixel.red), static_cast<char>(pixel.alpha)};
-      os.write(BGRA, 4);
+MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_pcx_without_pallete(const std::filesystem::path& path) const {
+  std::ofstream ofs{path, std::ios_base::binary};
+  write_as_pcx_without_pallete(ofs);
+}
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_pcx_without_pallete(std::ostream& os) const {
+  internal::write_to_stream(os, [this](auto& out) { internal::write_pcx(out, *this, false); });
+}
+
+MPCXPARSER_INLINE std::vector<std::uint8_t> mugen::pcx::Pcx::encode_as_pcx_without_pallete() const {
+  return internal::encode_to_vector(internal::pcx_size_bound(*this, false), [this](auto& out) { internal::write_pcx(out, *this, false); });
+}
+
+MPCXPARSER_INLINE std::size_t mugen::pcx::Pcx::encode_as_pcx_without_pallete(std::span<std::uint8_t> dest) const {
+  return internal::encode_to_span(dest, [this](auto& out) { internal::write_pcx(out, *this, false); });
+}
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_ico(const std::filesystem::path& path) const {
+  std::ofstream ofs{path, std::ios_base::binary};
+  write_as_ico(ofs);
+}
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_ico(std::ostream& os) const {
+  internal::validate_ico(*this);
+  internal::write_to_stream(os, [this](auto& out) { internal::write_ico(out, *this); });
+}
+
+MPCXPARSER_INLINE std::vector<std::uint8_t> mugen::pcx::Pcx::encode_as_ico() const {
+  internal::validate_ico(*this);
+  return internal::encode_to_vector(internal::ico_size(*this), [this](auto& out) { internal::write_ico(out, *this); });
+}
+
+MPCXPARSER_INLINE std::size_t mugen::pcx::Pcx::encode_as_ico(std::span<std::uint8_t> dest) const {
+  internal::validate_ico(*this);
+  return internal::encode_to_span(dest, [this](auto& out) { internal::write_ico(out, *this); });
+}
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_bmp(const std::filesystem::path& path) const {
+  std::ofstream ofs{path, std::ios_base::binary};
+  write_as_bmp(ofs);
+}
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_bmp(std::ostream& os) const {
+  internal::write_to_stream(os, [this](auto& out) { internal::write_bmp(out, *this); });
+}
+
+MPCXPARSER_INLINE std::vector<std::uint8_t> mugen::pcx::Pcx::encode_as_bmp() const {
+  return internal::encode_to_vector(internal::bmp_size(*this), [this](auto& out) { internal::write_bmp(out, *this); });
+}
+
+MPCXPARSER_INLINE std::size_t mugen::pcx::Pcx::encode_as_bmp(std::span<std::uint8_t> dest) const {
+  return internal::encode_to_span(dest, [this](auto& out) { internal::write_bmp(out, *this); });
+}
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_abmp(const std::filesystem::path& path) const {
+  std::ofstream ofs{path, std::ios_base::binary};
+  write_as_abmp(ofs);
+}
+
+MPCXPARSER_INLINE void mugen::pcx::Pcx::write_as_abmp(std::ostream& os) const {
+  internal::write_to_stream(os, [this](auto& out) { internal::write_abmp(out, *this); });
+}
+
+MPCXPARSER_INLINE std::vector<std::uint8_t> mugen::pcx::Pcx::encode_as_abmp() const {
+  return internal::encode_to_vector(internal::abmp_size(*this), [this](auto& out) { internal::write_abmp(out, *this); });
+}
+
+MPCXPARSER_INLINE std::size_t mugen::pcx::Pcx::encode_as_abmp(std::span<std::uint8_t> dest) const {
+  return internal::encode_to_span(dest, [this](auto& out) { internal::write_abmp(out, *this); });
+}
+
+MPCXPARSER_INLINE mugen::pcx::Pcx::SharedPallete mugen::pcx::PalleteCache::intern(const std::array<Pcx::Pixel, 256>& pallete) {
+  auto hash = std::hash<std::string_view>{}(std::string_view{std::bit_cast<const char*>(pallete.data()), sizeof(pallete)});
+
+  std::lock_guard lock{mutex_};
+  auto [first, last] = palletes_.equal_range(hash);
+  for (auto it = first; it != last; ++it) {
+    if (**(it->second) == pallete) {
+      return it->second;
     }
   }
+
+  return palletes_.emplace(hash, std::make_shared<const std::optional<std::array<Pcx::Pixel, 256>>>(pallete))->second;
+}
+
+MPCXPARSER_INLINE std::size_t mugen::pcx::PalleteCache::size() const {
+  std::lock_guard lock{mutex_};
+  return palletes_.size();
+}
+
+MPCXPARSER_INLINE void mugen::pcx::PalleteCache::clear() {
+  std::lock_guard lock{mutex_};
+  palletes_.clear();
 }
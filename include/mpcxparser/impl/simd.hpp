@@ -0,0 +1,519 @@
+/**
+ * @file simd.hpp
+ * @author Halkaze
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPCXPARSER_IMPL_SIMD_HPP__
+#define MPCXPARSER_IMPL_SIMD_HPP__
+
+#include "mpcxparser/mpcxparser.h"
+
+#include <bit>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MPCXPARSER_SIMD_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+#if defined(MPCXPARSER_SIMD_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MPCXPARSER_SIMD_SSE2 1
+#endif
+
+// AVX2 のカーネルはコンパイルオプションに関係なく生成し、実行時に CPU の対応状況を見て選択する
+#if defined(MPCXPARSER_SIMD_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+#define MPCXPARSER_TARGET_AVX2
+#else
+#define MPCXPARSER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace mugen {
+namespace pcx {
+namespace internal {
+namespace simd {
+
+static inline bool cpu_supports_avx2() noexcept {
+#if defined(MPCXPARSER_SIMD_X86) && defined(_MSC_VER) && !defined(__clang__)
+  int info[4]{};
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+
+  // OSXSAVE と AVX に対応しており、OS が YMM レジスタを保存するか確認
+  __cpuid(info, 1);
+  if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#elif defined(MPCXPARSER_SIMD_X86)
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+// ==== Run fill ====
+
+static inline void fill_run_default(std::uint8_t* dest, std::uint8_t value, std::size_t n) noexcept {
+  std::memset(dest, value, n);
+}
+
+#if defined(MPCXPARSER_SIMD_X86)
+MPCXPARSER_TARGET_AVX2 static inline void fill_run_avx2(std::uint8_t* dest, std::uint8_t value, std::size_t n) noexcept {
+  if (n < 32) {
+    std::memset(dest, value, n);
+    return;
+  }
+
+  // 末尾は直前のストアと重なってもよいので、32 バイト単位に満たない分も 1 回のストアで埋める
+  auto v = _mm256_set1_epi8(static_cast<char>(value));
+  for (std::size_t i = 0; i + 32 < n; i += 32) {
+    _mm256_storeu_si256(std::bit_cast<__m256i*>(dest + i), v);
+  }
+  _mm256_storeu_si256(std::bit_cast<__m256i*>(dest + n - 32), v);
+}
+#endif
+
+// ==== Literal scan ====
+
+// 先頭から連続する、ランレングスのマーカー（上位 2 ビットが立っている）でないバイトの数を返す
+static inline std::size_t count_literals_default(const std::uint8_t* src, std::size_t n) noexcept {
+  std::size_t i = 0;
+
+#if defined(MPCXPARSER_SIMD_SSE2)
+  const auto marker = _mm_set1_epi8(static_cast<char>(0xC0));
+  for (; i + 16 <= n; i += 16) {
+    auto v = _mm_loadu_si128(std::bit_cast<const __m128i*>(src + i));
+    auto mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, marker), marker)));
+    if (mask != 0) {
+      return i + std::countr_zero(mask);
+    }
+  }
+#endif
+
+  for (; i < n; ++i) {
+    if ((src[i] & 0xC0) == 0xC0) {
+      break;
+    }
+  }
+  return i;
+}
+
+#if defined(MPCXPARSER_SIMD_X86)
+MPCXPARSER_TARGET_AVX2 static inline std::size_t count_literals_avx2(const std::uint8_t* src, std::size_t n) noexcept {
+  std::size_t i = 0;
+
+  const auto marker = _mm256_set1_epi8(static_cast<char>(0xC0));
+  for (; i + 32 <= n; i += 32) {
+    auto v = _mm256_loadu_si256(std::bit_cast<const __m256i*>(src + i));
+    auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(v, marker), marker)));
+    if (mask != 0) {
+      return i + std::countr_zero(mask);
+    }
+  }
+
+  return i + count_literals_default(src + i, n - i);
+}
+#endif
+
+// ==== Plane interleave ====
+
+// R/G/B の各プレーンから n ピクセル分を RGBA（A = 255）の並びで dest に書き込む
+static inline void interleave_rgb_default(const std::uint8_t* red,
+                                          const std::uint8_t* green,
+                                          const std::uint8_t* blue,
+                                          std::uint8_t* dest,
+                                          std::size_t n) noexcept {
+  std::size_t i = 0;
+
+#if defined(MPCXPARSER_SIMD_SSE2)
+  const auto alpha = _mm_set1_epi8(static_cast<char>(0xFF));
+  for (; i + 16 <= n; i += 16) {
+    auto r = _mm_loadu_si128(std::bit_cast<const __m128i*>(red + i));
+    auto g = _mm_loadu_si128(std::bit_cast<const __m128i*>(green + i));
+    auto b = _mm_loadu_si128(std::bit_cast<const __m128i*>(blue + i));
+
+    auto rgLo = _mm_unpacklo_epi8(r, g);
+    auto rgHi = _mm_unpackhi_epi8(r, g);
+    auto baLo = _mm_unpacklo_epi8(b, alpha);
+    auto baHi = _mm_unpackhi_epi8(b, alpha);
+
+    auto* p = std::bit_cast<__m128i*>(dest + i * 4);
+    _mm_storeu_si128(p + 0, _mm_unpacklo_epi16(rgLo, baLo));
+    _mm_storeu_si128(p + 1, _mm_unpackhi_epi16(rgLo, baLo));
+    _mm_storeu_si128(p + 2, _mm_unpacklo_epi16(rgHi, baHi));
+    _mm_storeu_si128(p + 3, _mm_unpackhi_epi16(rgHi, baHi));
+  }
+#endif
+
+  for (; i < n; ++i) {
+    dest[i * 4 + 0] = red[i];
+    dest[i * 4 + 1] = green[i];
+    dest[i * 4 + 2] = blue[i];
+    dest[i * 4 + 3] = 0xFF;
+  }
+}
+
+#if defined(MPCXPARSER_SIMD_X86)
+MPCXPARSER_TARGET_AVX2 static inline void interleave_rgb_avx2(const std::uint8_t* red,
+                                                              const std::uint8_t* green,
+                                                              const std::uint8_t* blue,
+                                                              std::uint8_t* dest,
+                                                              std::size_t n) noexcept {
+  std::size_t i = 0;
+
+  // unpack は 128 ビットのレーンごとに行われるため、最後にレーンを並べ直す
+  const auto alpha = _mm256_set1_epi8(static_cast<char>(0xFF));
+  for (; i + 32 <= n; i += 32) {
+    auto r = _mm256_loadu_si256(std::bit_cast<const __m256i*>(red + i));
+    auto g = _mm256_loadu_si256(std::bit_cast<const __m256i*>(green + i));
+    auto b = _mm256_loadu_si256(std::bit_cast<const __m256i*>(blue + i));
+
+    auto rgLo = _mm256_unpacklo_epi8(r, g);
+    auto rgHi = _mm256_unpackhi_epi8(r, g);
+    auto baLo = _mm256_unpacklo_epi8(b, alpha);
+    auto baHi = _mm256_unpackhi_epi8(b, alpha);
+
+    auto p0 = _mm256_unpacklo_epi16(rgLo, baLo);  // 0-3   | 16-19
+    auto p1 = _mm256_unpackhi_epi16(rgLo, baLo);  // 4-7   | 20-23
+    auto p2 = _mm256_unpacklo_epi16(rgHi, baHi);  // 8-11  | 24-27
+    auto p3 = _mm256_unpackhi_epi16(rgHi, baHi);  // 12-15 | 28-31
+
+    auto* p = std::bit_cast<__m256i*>(dest + i * 4);
+    _mm256_storeu_si256(p + 0, _mm256_permute2x128_si256(p0, p1, 0x20));
+    _mm256_storeu_si256(p + 1, _mm256_permute2x128_si256(p2, p3, 0x20));
+    _mm256_storeu_si256(p + 2, _mm256_permute2x128_si256(p0, p1, 0x31));
+    _mm256_storeu_si256(p + 3, _mm256_permute2x128_si256(p2, p3, 0x31));
+  }
+
+  interleave_rgb_default(red + i, green + i, blue + i, dest + i * 4, n - i);
+}
+#endif
+
+// RGBA の並びの n ピクセルを R/G/B の各プレーンに分けて書き込む（A は読み捨てる）
+static inline void deinterleave_rgb_default(const std::uint8_t* src,
+                                            std::uint8_t* red,
+                                            std::uint8_t* green,
+                                            std::uint8_t* blue,
+                                            std::size_t n) noexcept {
+  std::size_t i = 0;
+
+#if defined(MPCXPARSER_SIMD_SSE2)
+  // 各チャンネルを 32 ビットの下位に取り出してから、16 ビット、8 ビットへと詰める
+  const auto low = _mm_set1_epi32(0xFF);
+  for (; i + 16 <= n; i += 16) {
+    const auto* p = std::bit_cast<const __m128i*>(src + i * 4);
+    __m128i v[4] = {_mm_loadu_si128(p + 0), _mm_loadu_si128(p + 1), _mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)};
+
+    auto channel = [&](int shift) noexcept {
+      auto c0 = _mm_and_si128(_mm_srli_epi32(v[0], shift), low);
+      auto c1 = _mm_and_si128(_mm_srli_epi32(v[1], shift), low);
+      auto c2 = _mm_and_si128(_mm_srli_epi32(v[2], shift), low);
+      auto c3 = _mm_and_si128(_mm_srli_epi32(v[3], shift), low);
+      return _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+    };
+
+    _mm_storeu_si128(std::bit_cast<__m128i*>(red + i), channel(0));
+    _mm_storeu_si128(std::bit_cast<__m128i*>(green + i), channel(8));
+    _mm_storeu_si128(std::bit_cast<__m128i*>(blue + i), channel(16));
+  }
+#endif
+
+  for (; i < n; ++i) {
+    red[i] = src[i * 4 + 0];
+    green[i] = src[i * 4 + 1];
+    blue[i] = src[i * 4 + 2];
+  }
+}
+
+#if defined(MPCXPARSER_SIMD_X86)
+MPCXPARSER_TARGET_AVX2 static inline void deinterleave_rgb_avx2(const std::uint8_t* src,
+                                                                std::uint8_t* red,
+                                                                std::uint8_t* green,
+                                                                std::uint8_t* blue,
+                                                                std::size_t n) noexcept {
+  std::size_t i = 0;
+
+  // レーン内で RRRR GGGG BBBB AAAA に並べ、8 ピクセルごとに R/G/B/A の 8 バイトずつにまとめる
+  const auto shuffle = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                        0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+  const auto order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  for (; i + 32 <= n; i += 32) {
+    const auto* p = std::bit_cast<const __m256i*>(src + i * 4);
+    auto v0 = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(_mm256_loadu_si256(p + 0), shuffle), order);  // R G B A : 0-7
+    auto v1 = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(_mm256_loadu_si256(p + 1), shuffle), order);  // R G B A : 8-15
+    auto v2 = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(_mm256_loadu_si256(p + 2), shuffle), order);  // R G B A : 16-23
+    auto v3 = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(_mm256_loadu_si256(p + 3), shuffle), order);  // R G B A : 24-31
+
+    auto rb0 = _mm256_unpacklo_epi64(v0, v1);  // R 0-15  | B 0-15
+    auto ga0 = _mm256_unpackhi_epi64(v0, v1);  // G 0-15  | A 0-15
+    auto rb1 = _mm256_unpacklo_epi64(v2, v3);  // R 16-31 | B 16-31
+    auto ga1 = _mm256_unpackhi_epi64(v2, v3);  // G 16-31 | A 16-31
+
+    _mm256_storeu_si256(std::bit_cast<__m256i*>(red + i), _mm256_permute2x128_si256(rb0, rb1, 0x20));
+    _mm256_storeu_si256(std::bit_cast<__m256i*>(green + i), _mm256_permute2x128_si256(ga0, ga1, 0x20));
+    _mm256_storeu_si256(std::bit_cast<__m256i*>(blue + i), _mm256_permute2x128_si256(rb0, rb1, 0x31));
+  }
+
+  deinterleave_rgb_default(src + i * 4, red + i, green + i, blue + i, n - i);
+}
+#endif
+
+// ==== Pixel swizzle ====
+
+// RGBA の並びの 1 ピクセルから、format の i バイト目に置くバイトの位置
+static inline std::array<std::uint8_t, 4> channel_order(PixelFormat format) noexcept {
+  switch (format) {
+    case PixelFormat::BGRA8888:
+      return {2, 1, 0, 3};
+    case PixelFormat::ARGB8888:
+      return {3, 0, 1, 2};
+    default:
+      return {0, 1, 2, 3};
+  }
+}
+
+// RGBA の並びの n ピクセルを format の並びで dest に書き込む
+// src と dest は同じ領域でもよい
+static inline void swizzle_default(const std::uint8_t* src, std::uint8_t* dest, std::size_t n, PixelFormat format) noexcept {
+  auto order = channel_order(format);
+  for (std::size_t i = 0; i < n; ++i) {
+    std::uint8_t pixel[4] = {src[i * 4 + order[0]], src[i * 4 + order[1]], src[i * 4 + order[2]], src[i * 4 + order[3]]};
+    std::memcpy(dest + i * 4, pixel, 4);
+  }
+}
+
+#if defined(MPCXPARSER_SIMD_X86)
+MPCXPARSER_TARGET_AVX2 static inline void swizzle_avx2(const std::uint8_t* src, std::uint8_t* dest, std::size_t n, PixelFormat format) noexcept {
+  std::size_t i = 0;
+
+  auto order = channel_order(format);
+  std::uint8_t mask[32];
+  for (std::size_t j = 0; j < 32; ++j) {
+    mask[j] = static_cast<std::uint8_t>(j / 4 * 4 % 16 + order[j % 4]);
+  }
+
+  auto shuffle = _mm256_loadu_si256(std::bit_cast<const __m256i*>(&mask[0]));
+  for (; i + 8 <= n; i += 8) {
+    auto v = _mm256_loadu_si256(std::bit_cast<const __m256i*>(src + i * 4));
+    _mm256_storeu_si256(std::bit_cast<__m256i*>(dest + i * 4), _mm256_shuffle_epi8(v, shuffle));
+  }
+
+  swizzle_default(src + i * 4, dest + i * 4, n - i, format);
+}
+#endif
+
+// ==== Pallete lookup ====
+
+// n 個のインデックスを 256 要素の lut で引いて、1 ピクセル 4 バイトで dest に書き込む
+// dest は、書き込み先より後ろのインデックスと重ならなければ indexes と同じ領域でもよい
+static inline void lookup_default(const std::uint8_t* indexes, const std::uint32_t* lut, std::uint8_t* dest, std::size_t n) noexcept {
+  for (std::size_t i = 0; i < n; ++i) {
+    std::memcpy(dest + i * 4, lut + indexes[i], 4);
+  }
+}
+
+#if defined(MPCXPARSER_SIMD_X86)
+MPCXPARSER_TARGET_AVX2 static inline void lookup_avx2(const std::uint8_t* indexes, const std::uint32_t* lut, std::uint8_t* dest, std::size_t n) noexcept {
+  std::size_t i = 0;
+
+  // 8 個のインデックスを読み出してから書き込むため、直後のインデックスまでは上書きしない
+  for (; i + 8 <= n; i += 8) {
+    auto index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(std::bit_cast<const __m128i*>(indexes + i)));
+    auto v = _mm256_i32gather_epi32(std::bit_cast<const int*>(lut), index, 4);
+    _mm256_storeu_si256(std::bit_cast<__m256i*>(dest + i * 4), v);
+  }
+
+  lookup_default(indexes + i, lut, dest + i * 4, n - i);
+}
+#endif
+
+// lookup で使用する、format の並びに変換したパレット
+static inline std::array<std::uint32_t, 256> pack_pallete(const std::array<Pcx::Pixel, 256>& pallete, PixelFormat format) noexcept {
+  std::array<std::uint32_t, 256> lut;
+  swizzle_default(std::bit_cast<const std::uint8_t*>(pallete.data()), std::bit_cast<std::uint8_t*>(lut.data()), lut.size(), format);
+  return lut;
+}
+
+// ==== Run length encoding ====
+
+// len バイトの value のランを 1 - 2 バイトずつで出力する（1 つのランは高々 0x3F バイト）
+static inline std::uint8_t* put_runs(std::uint8_t* dest, std::size_t len, std::uint8_t value) noexcept {
+  for (; len > 0x3F; len -= 0x3F) {
+    *dest++ = 0xFF;
+    *dest++ = value;
+  }
+
+  if (len <= 2 && value < 0xC0) {
+    *dest++ = value;
+    if (len == 2) {
+      *dest++ = value;
+    }
+  } else if (len > 0) {
+    *dest++ = static_cast<std::uint8_t>(len | 0xC0);
+    *dest++ = value;
+  }
+  return dest;
+}
+
+// src[start] から src[n - 1] までを 1 バイトずつ比較しながら出力する
+static inline std::uint8_t* put_runs_from(const std::uint8_t* src, std::size_t start, std::size_t n, std::uint8_t* dest) noexcept {
+  for (auto i = start; i < n; ++i) {
+    if (i + 1 == n || src[i] != src[i + 1]) {
+      dest = put_runs(dest, i + 1 - start, src[start]);
+      start = i + 1;
+    }
+  }
+  return dest;
+}
+
+// src の n バイトを PCX のランレングスで dest に書き込み、書き込んだバイト数を返す
+// dest には n * 2 バイト以上が必要
+static inline std::size_t encode_rle_default(const std::uint8_t* src, std::size_t n, std::uint8_t* dest) noexcept {
+  auto* p = dest;
+  std::size_t start = 0;
+
+#if defined(MPCXPARSER_SIMD_SSE2)
+  // 隣り合うバイトを比較し、値の変わる位置ごとにランを出力する
+  for (std::size_t i = 0; i + 17 <= n; i += 16) {
+    auto a = _mm_loadu_si128(std::bit_cast<const __m128i*>(src + i));
+    auto b = _mm_loadu_si128(std::bit_cast<const __m128i*>(src + i + 1));
+    auto mask = ~static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b))) & 0xFFFF;
+    for (; mask != 0; mask &= mask - 1) {
+      auto end = i + std::countr_zero(mask) + 1;
+      p = put_runs(p, end - start, src[start]);
+      start = end;
+    }
+  }
+#endif
+
+  return static_cast<std::size_t>(put_runs_from(src, start, n, p) - dest);
+}
+
+#if defined(MPCXPARSER_SIMD_X86)
+MPCXPARSER_TARGET_AVX2 static inline std::size_t encode_rle_avx2(const std::uint8_t* src, std::size_t n, std::uint8_t* dest) noexcept {
+  auto* p = dest;
+  std::size_t start = 0;
+
+  for (std::size_t i = 0; i + 33 <= n; i += 32) {
+    auto a = _mm256_loadu_si256(std::bit_cast<const __m256i*>(src + i));
+    auto b = _mm256_loadu_si256(std::bit_cast<const __m256i*>(src + i + 1));
+    auto mask = ~static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+    for (; mask != 0; mask &= mask - 1) {
+      auto end = i + std::countr_zero(mask) + 1;
+      p = put_runs(p, end - start, src[start]);
+      start = end;
+    }
+  }
+
+  return static_cast<std::size_t>(put_runs_from(src, start, n, p) - dest);
+}
+#endif
+
+// ==== Transparency mask ====
+
+// n 個のインデックスのうち 0 であるものを、先頭を最上位ビットとして 1 ビットずつ dest に書き込む
+// dest には (n + 7) / 8 バイトが書き込まれる
+static inline void mask_zero_default(const std::uint8_t* src, std::uint8_t* dest, std::size_t n) noexcept {
+  std::size_t i = 0;
+
+#if defined(MPCXPARSER_SIMD_SSE2)
+  const auto zero = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    auto v = _mm_loadu_si128(std::bit_cast<const __m128i*>(src + i));
+    auto bits = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)));
+
+    // movemask では先頭が最下位ビットになるため、バイトごとにビットの並びを反転する
+    bits = ((bits & 0xF0F0) >> 4) | ((bits & 0x0F0F) << 4);
+    bits = ((bits & 0xCCCC) >> 2) | ((bits & 0x3333) << 2);
+    bits = ((bits & 0xAAAA) >> 1) | ((bits & 0x5555) << 1);
+    dest[i / 8 + 0] = static_cast<std::uint8_t>(bits);
+    dest[i / 8 + 1] = static_cast<std::uint8_t>(bits >> 8);
+  }
+#endif
+
+  for (; i < n; i += 8) {
+    std::uint8_t bits = 0;
+    for (std::size_t j = 0; j < 8 && i + j < n; ++j) {
+      if (src[i + j] == 0) {
+        bits |= static_cast<std::uint8_t>(0x80 >> j);
+      }
+    }
+    dest[i / 8] = bits;
+  }
+}
+
+#if defined(MPCXPARSER_SIMD_X86)
+MPCXPARSER_TARGET_AVX2 static inline void mask_zero_avx2(const std::uint8_t* src, std::uint8_t* dest, std::size_t n) noexcept {
+  std::size_t i = 0;
+
+  // 8 バイトごとに並びを反転してから比較し、movemask の各バイトの最上位ビットが先頭になるようにする
+  const auto reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  const auto zero = _mm256_setzero_si256();
+  for (; i + 32 <= n; i += 32) {
+    auto v = _mm256_shuffle_epi8(_mm256_loadu_si256(std::bit_cast<const __m256i*>(src + i)), reverse);
+    auto bits = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero)));
+    std::memcpy(dest + i / 8, &bits, sizeof(bits));
+  }
+
+  mask_zero_default(src + i, dest + i / 8, n - i);
+}
+#endif
+
+// ==== Dispatch ====
+
+struct Kernels {
+  void (*fill_run)(std::uint8_t* dest, std::uint8_t value, std::size_t n) noexcept;
+  std::size_t (*count_literals)(const std::uint8_t* src, std::size_t n) noexcept;
+  void (*interleave_rgb)(const std::uint8_t* red, const std::uint8_t* green, const std::uint8_t* blue, std::uint8_t* dest, std::size_t n) noexcept;
+  void (*deinterleave_rgb)(const std::uint8_t* src, std::uint8_t* red, std::uint8_t* green, std::uint8_t* blue, std::size_t n) noexcept;
+  void (*swizzle)(const std::uint8_t* src, std::uint8_t* dest, std::size_t n, PixelFormat format) noexcept;
+  void (*lookup)(const std::uint8_t* indexes, const std::uint32_t* lut, std::uint8_t* dest, std::size_t n) noexcept;
+  std::size_t (*encode_rle)(const std::uint8_t* src, std::size_t n, std::uint8_t* dest) noexcept;
+  void (*mask_zero)(const std::uint8_t* src, std::uint8_t* dest, std::size_t n) noexcept;
+};
+
+// 実行中の CPU で使用可能なカーネルを返す
+static inline const Kernels& kernels() noexcept {
+  static const Kernels selected = []() noexcept {
+#if defined(MPCXPARSER_SIMD_X86)
+    if (cpu_supports_avx2()) {
+      return Kernels{fill_run_avx2, count_literals_avx2, interleave_rgb_avx2, deinterleave_rgb_avx2, swizzle_avx2, lookup_avx2, encode_rle_avx2, mask_zero_avx2};
+    }
+#endif
+    return Kernels{fill_run_default, count_literals_default, interleave_rgb_default, deinterleave_rgb_default, swizzle_default, lookup_default, encode_rle_default, mask_zero_default};
+  }();
+  return selected;
+}
+
+};  // namespace simd
+};  // namespace internal
+};  // namespace pcx
+};  // namespace mugen
+
+#endif  // MPCXPARSER_IMPL_SIMD_HPP__
@@ -24,16 +24,25 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <compare>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <filesystem>
+#include <functional>
 #include <istream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <ostream>
 #include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #ifndef MPCXPARSER_PACK
@@ -52,10 +61,48 @@ enum class MugenVersion {
   // Latest, 必要になったら実装できるように
 };
 
+// パレット形式のPCXについて、RGBA形式のデータ（Pcx::data）を展開するタイミング
+enum class DataExpansion {
+  Lazy,   // Pcx::data の初回呼び出し時に展開する
+  Eager,  // Pcx の構築時に展開する
+  None,   // 展開しない（Pcx::data は空となる）
+};
+
+// RGBA形式のデータの並び
+enum class PixelLayout {
+  Interleaved,  // 画素ごとに並べる（Pcx::data）
+  Planar,       // チャンネルごとに分けて並べる（Pcx::planes）
+};
+
+// 1 ピクセルを std::uint32_t に詰めた形式
+// 名前はメモリ上のバイトの並びを表す（Pcx::Pixel と同じ並びは RGBA8888）
+enum class PixelFormat {
+  RGBA8888,
+  BGRA8888,  // BMP / ICO と同じ並び
+  ARGB8888,
+};
+
+class PalleteCache;
+
+struct ParseOptions {
+  DataExpansion dataExpansion = DataExpansion::Lazy;
+  PixelLayout pixelLayout = PixelLayout::Interleaved;  // 構築時に用意する形式、もう一方は初回呼び出し時に展開する
+  std::shared_ptr<PalleteCache> palleteCache{};         // 指定した場合、同じ内容のパレットを共有する
+};
+
 class Pcx;
+struct PcxInfo;
+struct PcxRegion;
+struct PcxRow;
+struct ParseResult;
+struct PcxBuffers;
+struct PcxPalleteInfo;
 
 template <MugenVersion Version>
 class PcxParser {
+ private:
+  ParseOptions options_;
+
  public:
   PcxParser(const PcxParser&) = delete;
   PcxParser& operator=(const PcxParser&) = delete;
@@ -64,6 +111,9 @@ class PcxParser {
   PcxParser& operator=(PcxParser&&) = default;
 
   explicit PcxParser() noexcept;
+  explicit PcxParser(const ParseOptions& options) noexcept;
+
+  inline const ParseOptions& options() const noexcept { return options_; }
 
   Pcx parse(std::istream& is) const;
 
@@ -73,6 +123,69 @@ class PcxParser {
   Pcx parse(std::span<std::uint8_t, Extent> mem) const;
 
   Pcx parse(const std::uint8_t* mem, std::size_t length) const;
+
+  // 読み込めない PCX に対しては例外を送出せず、エラーの種類を返す（メモリの確保に失敗した場合を除く）
+  // parse はこれらが返したエラーを例外として送出する
+  ParseResult try_parse(std::istream& is) const;
+
+  ParseResult try_parse(const std::filesystem::path& pcx) const;
+
+  template <std::size_t Extent>
+  ParseResult try_parse(std::span<std::uint8_t, Extent> mem) const;
+
+  ParseResult try_parse(const std::uint8_t* mem, std::size_t length) const;
+
+  // region の範囲のみを展開する
+  // region より前の行は読み飛ばし、region の最後の行を展開した時点で本体の読み出しを終える
+  // パレットは末尾から直接読み出す
+  Pcx parse(const std::filesystem::path& pcx, const PcxRegion& region) const;
+
+  template <std::size_t Extent>
+  Pcx parse(std::span<std::uint8_t, Extent> mem, const PcxRegion& region) const;
+
+  Pcx parse(const std::uint8_t* mem, std::size_t length, const PcxRegion& region) const;
+
+  // 1 行展開するたびに onRow を呼び出し、画像全体は保持しない
+  // 1 行分の作業領域（24bit 形式では PcxInfo::line_size() バイトを含む）は最初に一度だけ確保する
+  // パレット形式の場合、パレットは末尾から先に読み出す
+  // DataExpansion::None の場合、パレット形式では PcxRow::data は空となる
+  void parse_rows(const std::filesystem::path& pcx, const std::function<void(const PcxRow&)>& onRow) const;
+
+  template <std::size_t Extent>
+  void parse_rows(std::span<std::uint8_t, Extent> mem, const std::function<void(const PcxRow&)>& onRow) const;
+
+  void parse_rows(const std::uint8_t* mem, std::size_t length, const std::function<void(const PcxRow&)>& onRow) const;
+
+  // ヘッダーのみを読み出し、展開に必要な情報を返す
+  // 検証は parse と同じ規則で行う
+  PcxInfo probe(std::istream& is) const;
+
+  PcxInfo probe(const std::filesystem::path& pcx) const;
+
+  template <std::size_t Extent>
+  PcxInfo probe(std::span<std::uint8_t, Extent> mem) const;
+
+  PcxInfo probe(const std::uint8_t* mem, std::size_t length) const;
+
+  // 呼び出し元が用意したバッファに展開し、ヒープ上の確保は行わない
+  // 必要なバッファのサイズは probe で得られる PcxInfo から求められる
+  // バッファが不足している場合は std::invalid_argument を送出する
+  template <std::size_t Extent>
+  PcxInfo parse_into(std::span<std::uint8_t, Extent> mem, const PcxBuffers& buffers) const;
+
+  PcxInfo parse_into(const std::uint8_t* mem, std::size_t length, const PcxBuffers& buffers) const;
+
+  // 本体を展開せず、末尾のパレットのみを読み出す
+  // 末尾に 256 色パレットが無い場合はヘッダーの EGA パレットを返す
+  // シークできないストリームの場合は本体を読み飛ばしてパレットを探す
+  PcxPalleteInfo read_pallete(std::istream& is) const;
+
+  PcxPalleteInfo read_pallete(const std::filesystem::path& pcx) const;
+
+  template <std::size_t Extent>
+  PcxPalleteInfo read_pallete(std::span<std::uint8_t, Extent> mem) const;
+
+  PcxPalleteInfo read_pallete(const std::uint8_t* mem, std::size_t length) const;
 };
 
 using PcxParserWin = PcxParser<MugenVersion::Win>;
@@ -82,6 +195,7 @@ using PcxParserWin = PcxParser<MugenVersion::Win>;
 
 #include "mpcxparser/exception.hpp"
 #include "mpcxparser/mugenpcx.hpp"
+#include "mpcxparser/decoder.hpp"
 
 #ifdef MPCXPARSER_HEADER_ONLY
 #include "mpcxparser/impl/mpcxparser.cpp"
@@ -40,43 +40,287 @@ class Pcx {
     auto operator<=>(const Pixel&) const noexcept = default;
   };
 
+  // RGBA形式のデータをチャンネルごとに分けたもの
+  // 各プレーンは data() と同じ順に width * height 要素を持つ
+  struct Planes {
+    std::vector<std::uint8_t> red;
+    std::vector<std::uint8_t> green;
+    std::vector<std::uint8_t> blue;
+    std::vector<std::uint8_t> alpha;
+
+    auto operator<=>(const Planes&) const = default;
+  };
+
+  // 複数の Pcx で共有する、変更されないパレット
+  // PalleteCache を使用してパースした場合、同じ内容のパレットは同じものを指す
+  using SharedPallete = std::shared_ptr<const std::optional<std::array<Pixel, 256>>>;
+
  private:
-  const std::size_t width_;
-  const std::size_t height_;
+  // 構築時に用意しなかった形式を、data() / planes() の初回呼び出し時に展開する領域
+  struct ExpandedData {
+    std::once_flag once;
+    std::vector<Pixel> data;
+    std::once_flag planesOnce;
+    Planes planes;
+  };
+
+  // ExpandedData を初回の展開時に確保して保持する
+  // 複数のスレッドから同時に確保された場合は、最初に設定されたもの以外を破棄する
+  class ExpandedSlot {
+    mutable std::atomic<ExpandedData*> data_;
+
+   public:
+    inline ExpandedSlot() noexcept : data_{nullptr} {}
+    inline ExpandedSlot(ExpandedSlot&& other) noexcept : data_{other.data_.exchange(nullptr)} {}
+
+    inline ExpandedSlot& operator=(ExpandedSlot&& other) noexcept {
+      if (this != &other) {
+        delete data_.exchange(other.data_.exchange(nullptr));
+      }
+      return *this;
+    }
+
+    inline ~ExpandedSlot() { delete data_.load(); }
+
+    inline ExpandedData& get() const {
+      auto* data = data_.load(std::memory_order_acquire);
+      if (data == nullptr) {
+        auto created = std::make_unique<ExpandedData>();
+        if (data_.compare_exchange_strong(data, created.get(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+          data = created.release();
+        }
+      }
+      return *data;
+    }
+  };
+
+  std::size_t width_;
+  std::size_t height_;
+
+  std::size_t bytesPerLine_;
+
+  SharedPallete pallete_;  // 24bit 形式の場合は持たない
+  std::optional<std::vector<std::uint8_t>> indexes_;
+
+  std::vector<Pixel> data_;
+  Planes planes_;
+
+  // true の場合は expanded_ に展開する
+  bool lazyData_;
+  bool lazyPlanes_;
+  ExpandedSlot expanded_;
+
+  // パレット形式の場合はインデックスから、そうでなければプレーンから並べ直す
+  inline std::vector<Pixel> expand() const {
+    if (indexes_) {
+      std::vector<Pixel> data(indexes_->size());
+      expand_indexes(*indexes_, **pallete_, data);
+      return data;
+    }
 
-  const std::size_t bytesPerLine_;
+    std::vector<Pixel> data(planes_.alpha.size());
+    for (std::size_t i = 0; i < data.size(); ++i) {
+      data[i].red = planes_.red[i];
+      data[i].green = planes_.green[i];
+      data[i].blue = planes_.blue[i];
+      data[i].alpha = planes_.alpha[i];
+    }
+    return data;
+  }
 
-  const std::optional<std::array<Pixel, 256>> pallete_;
-  const std::optional<std::vector<std::uint8_t>> indexes_;
+  // パレット形式の場合はインデックスから、そうでなければ data() から分解する
+  inline Planes expand_planes() const {
+    const auto& data = indexes_ ? data_ : this->data();
+    auto n = indexes_ ? indexes_->size() : data.size();
+    Planes planes{
+        .red = std::vector<std::uint8_t>(n),
+        .green = std::vector<std::uint8_t>(n),
+        .blue = std::vector<std::uint8_t>(n),
+        .alpha = std::vector<std::uint8_t>(n),
+    };
+    for (std::size_t i = 0; i < n; ++i) {
+      const auto& pixel = indexes_ ? (**pallete_)[(*indexes_)[i]] : data[i];
+      planes.red[i] = pixel.red;
+      planes.green[i] = pixel.green;
+      planes.blue[i] = pixel.blue;
+      planes.alpha[i] = pixel.alpha;
+    }
+    return planes;
+  }
 
-  const std::vector<Pixel> data_;
+  static inline bool is_expanded(DataExpansion expansion, PixelLayout layout, PixelLayout target) noexcept {
+    return expansion == DataExpansion::Eager && layout == target;
+  }
+
+  static inline bool is_lazy(DataExpansion expansion, PixelLayout layout, PixelLayout target) noexcept {
+    return expansion != DataExpansion::None && !is_expanded(expansion, layout, target);
+  }
 
  public:
+  // planes() は初回呼び出し時に data から分解する
   inline explicit Pcx(std::size_t width, std::size_t height, std::size_t bytesPerLine, std::vector<Pixel>&& data) noexcept
-      : width_{width}, height_{height}, bytesPerLine_{bytesPerLine}, pallete_{}, indexes_{}, data_{data} {}
+      : width_{width},
+        height_{height},
+        bytesPerLine_{bytesPerLine},
+        pallete_{},
+        indexes_{},
+        data_{std::move(data)},
+        planes_{},
+        lazyData_{false},
+        lazyPlanes_{true},
+        expanded_{} {}
+
+  // data() は初回呼び出し時に planes から並べ直す
+  inline explicit Pcx(std::size_t width, std::size_t height, std::size_t bytesPerLine, Planes&& planes) noexcept
+      : width_{width},
+        height_{height},
+        bytesPerLine_{bytesPerLine},
+        pallete_{},
+        indexes_{},
+        data_{},
+        planes_{std::move(planes)},
+        lazyData_{true},
+        lazyPlanes_{false},
+        expanded_{} {}
 
+  // expansion は layout で指定した形式を展開するタイミングを表し、もう一方は初回呼び出し時に展開する
+  // DataExpansion::None の場合はどちらも展開しない
   inline explicit Pcx(std::size_t width,
                       std::size_t height,
                       std::size_t bytesPerLine,
                       std::array<Pixel, 256>&& pallete,
-                      std::vector<std::uint8_t>&& indexes) noexcept
-      : width_{width}, height_{height}, bytesPerLine_{bytesPerLine}, pallete_{pallete}, indexes_{indexes}, data_{[this]() {
-          std::vector<Pixel> data(indexes_->size());
-          std::transform(indexes_->cbegin(), indexes_->cend(), data.begin(), [this](std::uint8_t index) { return (*pallete_)[index]; });
-          return data;
-        }()} {}
+                      std::vector<std::uint8_t>&& indexes,
+                      DataExpansion expansion = DataExpansion::Lazy,
+                      PixelLayout layout = PixelLayout::Interleaved)
+      : Pcx{width,
+            height,
+            bytesPerLine,
+            std::make_shared<const std::optional<std::array<Pixel, 256>>>(std::move(pallete)),
+            std::move(indexes),
+            expansion,
+            layout} {}
+
+  // pallete は複製せずに共有する、pallete と *pallete は空であってはならない
+  inline explicit Pcx(std::size_t width,
+                      std::size_t height,
+                      std::size_t bytesPerLine,
+                      SharedPallete pallete,
+                      std::vector<std::uint8_t>&& indexes,
+                      DataExpansion expansion = DataExpansion::Lazy,
+                      PixelLayout layout = PixelLayout::Interleaved)
+      : width_{width},
+        height_{height},
+        bytesPerLine_{bytesPerLine},
+        pallete_{std::move(pallete)},
+        indexes_{std::move(indexes)},
+        data_{is_expanded(expansion, layout, PixelLayout::Interleaved) ? expand() : std::vector<Pixel>{}},
+        planes_{is_expanded(expansion, layout, PixelLayout::Planar) ? expand_planes() : Planes{}},
+        lazyData_{is_lazy(expansion, layout, PixelLayout::Interleaved)},
+        lazyPlanes_{is_lazy(expansion, layout, PixelLayout::Planar)},
+        expanded_{} {}
+
+  // 展開済みのデータは複製せず、複製先で改めて展開する
+  inline Pcx(const Pcx& other)
+      : width_{other.width_},
+        height_{other.height_},
+        bytesPerLine_{other.bytesPerLine_},
+        pallete_{other.pallete_},
+        indexes_{other.indexes_},
+        data_{other.data_},
+        planes_{other.planes_},
+        lazyData_{other.lazyData_},
+        lazyPlanes_{other.lazyPlanes_},
+        expanded_{} {}
+
+  Pcx(Pcx&&) noexcept = default;
 
-  auto operator<=>(const Pcx&) const noexcept = default;
+  inline Pcx& operator=(const Pcx& other) {
+    if (this != &other) {
+      *this = Pcx{other};
+    }
+    return *this;
+  }
+
+  Pcx& operator=(Pcx&&) noexcept = default;
+
+  // パレット形式の場合は pallete と indexes で比較し、data() は展開しない
+  // そのため DataExpansion の指定が異なっていても、同じ画像であれば等しい
+  inline bool operator==(const Pcx& other) const {
+    return width_ == other.width_ && height_ == other.height_ && bytesPerLine_ == other.bytesPerLine_ &&
+           (pallete_ == other.pallete_ || pallete() == other.pallete()) &&
+           indexes_ == other.indexes_ && (indexes_ || data() == other.data());
+  }
+
+  inline std::strong_ordering operator<=>(const Pcx& other) const {
+    if (auto cmp = width_ <=> other.width_; cmp != 0) {
+      return cmp;
+    }
+    if (auto cmp = height_ <=> other.height_; cmp != 0) {
+      return cmp;
+    }
+    if (auto cmp = bytesPerLine_ <=> other.bytesPerLine_; cmp != 0) {
+      return cmp;
+    }
+    if (auto cmp = pallete() <=> other.pallete(); cmp != 0) {
+      return cmp;
+    }
+    if (auto cmp = indexes_ <=> other.indexes_; cmp != 0 || indexes_) {
+      return cmp;
+    }
+    return data() <=> other.data();
+  }
 
   inline std::size_t width() const noexcept { return width_; }
   inline std::size_t height() const noexcept { return height_; }
 
   inline std::size_t bytes_per_line() const noexcept { return bytesPerLine_; }
 
-  inline const std::optional<std::array<Pixel, 256>>& pallete() const noexcept { return pallete_; }
+  inline const std::optional<std::array<Pixel, 256>>& pallete() const noexcept {
+    static const std::optional<std::array<Pixel, 256>> none{};
+    return pallete_ ? *pallete_ : none;
+  }
+
+  // 同じ内容のパレットを共有している Pcx どうしは同じものを返す
+  inline const SharedPallete& shared_pallete() const noexcept { return pallete_; }
   inline const std::optional<std::vector<std::uint8_t>>& indexes() const noexcept { return indexes_; }
 
-  inline const std::vector<Pixel>& data() const noexcept { return data_; }
+  // パレット形式の場合、DataExpansion::Lazy で構築されていれば初回呼び出し時に一度だけ展開する
+  // DataExpansion::None で構築されている場合は空となる
+  // これは画素がないことではなく展開していないことを表すため、indexes() や data_with() 、 pack() を使用すること
+  inline const std::vector<Pixel>& data() const {
+    if (lazyData_) {
+      auto& expanded = expanded_.get();
+      std::call_once(expanded.once, [this, &expanded]() { expanded.data = expand(); });
+      return expanded.data;
+    }
+    return data_;
+  }
+
+  // data() と同じ内容をチャンネルごとに分けたもの
+  // ParseOptions::pixelLayout が PixelLayout::Planar でなければ初回呼び出し時に一度だけ展開する
+  // パレット形式で DataExpansion::None で構築されている場合は空となる
+  inline const Planes& planes() const {
+    if (lazyPlanes_) {
+      auto& expanded = expanded_.get();
+      std::call_once(expanded.planesOnce, [this, &expanded]() { expanded.planes = expand_planes(); });
+      return expanded.planes;
+    }
+    return planes_;
+  }
+
+  // indexes を pallete で引いて dest（indexes.size() 要素以上）に書き込む
+  // 別のパレットを使用して data() と同じ形式に展開する場合にも使用できる
+  static void expand_indexes(std::span<const std::uint8_t> indexes, const std::array<Pixel, 256>& pallete, std::span<Pixel> dest);
+
+  // パレット形式の場合に、indexes() を複製せず pallete() の代わりに pallete で展開したデータを返す
+  // 24bit 形式の場合は data() と同じ内容となる
+  std::vector<Pixel> data_with(const std::array<Pixel, 256>& pallete) const;
+  void data_with(const std::array<Pixel, 256>& pallete, std::span<Pixel> dest) const;  // dest は width * height 要素
+
+  // format の並びで dest（width * height 要素）に書き込む
+  // パレット形式の場合は data() を展開せず、インデックスから直接書き込む
+  void pack(PixelFormat format, std::span<std::uint32_t> dest) const;
+  void pack(PixelFormat format, const std::array<Pixel, 256>& pallete, std::span<std::uint32_t> dest) const;  // pallete() の代わりに pallete を使用する
 
   // pcx形式として出力する
   void write_as_pcx(const std::filesystem::path& path) const;
@@ -97,6 +341,103 @@ class Pcx {
   // 透明度付きbmp形式（Windows95形式 = BITMAPV4）として出力する
   void write_as_abmp(const std::filesystem::path& path) const;
   void write_as_abmp(std::ostream& os) const;
+
+  // write_as_* と同じ内容をメモリ上に出力する
+  // std::vector を返すものは、出力するバイト数を事前に求めて一度だけ確保する（pcx形式は最大のバイト数で確保する）
+  // std::span に書き込むものは書き込んだバイト数を返し、不足した場合は std::invalid_argument を送出する
+  std::vector<std::uint8_t> encode_as_pcx() const;
+  std::size_t encode_as_pcx(std::span<std::uint8_t> dest) const;
+
+  std::vector<std::uint8_t> encode_as_pcx_without_pallete() const;
+  std::size_t encode_as_pcx_without_pallete(std::span<std::uint8_t> dest) const;
+
+  std::vector<std::uint8_t> encode_as_ico() const;
+  std::size_t encode_as_ico(std::span<std::uint8_t> dest) const;
+
+  std::vector<std::uint8_t> encode_as_bmp() const;
+  std::size_t encode_as_bmp(std::span<std::uint8_t> dest) const;
+
+  std::vector<std::uint8_t> encode_as_abmp() const;
+  std::size_t encode_as_abmp(std::span<std::uint8_t> dest) const;
+};
+
+// 同じ内容のパレットを 1 つにまとめて共有する
+// ParseOptions::palleteCache に指定すると、パースしたパレットをこのキャッシュから取り出す
+// 複数のスレッドから同時に使用できる
+class PalleteCache {
+  mutable std::mutex mutex_;
+  std::unordered_multimap<std::size_t, Pcx::SharedPallete> palletes_;  // キーはパレットのハッシュ値
+
+ public:
+  // pallete と同じ内容の共有パレットを返し、無ければ追加する
+  Pcx::SharedPallete intern(const std::array<Pcx::Pixel, 256>& pallete);
+
+  // 保持している共有パレットの数
+  std::size_t size() const;
+
+  // 保持している共有パレットを手放す、取り出し済みのパレットは使用中の Pcx が残っている間は有効
+  void clear();
+};
+
+// 展開する範囲
+// 画像からはみ出した部分は切り詰めるため、既定値は画像全体を表す
+struct PcxRegion {
+  std::size_t x = 0;
+  std::size_t y = 0;
+  std::size_t width = std::numeric_limits<std::size_t>::max();
+  std::size_t height = std::numeric_limits<std::size_t>::max();
+};
+
+// try_parse の結果
+struct ParseResult {
+  std::optional<Pcx> pcx;  // 失敗した場合は持たない
+  ErrorCode error;
+
+  inline explicit operator bool() const noexcept { return error == ErrorCode::None; }
+};
+
+// PCX の展開に必要な情報
+struct PcxInfo {
+  std::size_t width;
+  std::size_t height;
+  std::size_t bytesPerLine;
+  std::size_t colorPlanes;
+
+  // インデックス（パレット形式の場合）と RGBA 形式のデータに必要な要素数
+  inline std::size_t size() const noexcept { return width * height; }
+
+  // 24bit 形式の展開に使用する作業領域のバイト数
+  inline std::size_t line_size() const noexcept { return colorPlanes == 3 ? bytesPerLine * 3 + 0x3F : 0; }
+};
+
+// parse_into で展開先として使用する、呼び出し元が所有するバッファ
+// 空のバッファには展開しない
+struct PcxBuffers {
+  std::span<std::uint8_t> indexes{};  // パレット形式の場合のみ使用、PcxInfo::size() 要素
+  std::span<Pcx::Pixel> pallete{};    // パレット形式の場合のみ使用、256 要素
+  std::span<Pcx::Pixel> data{};       // PcxInfo::size() 要素
+
+  // data と同じ内容を packedFormat の並びで書き込む、PcxInfo::size() 要素
+  std::span<std::uint32_t> packed{};
+  PixelFormat packedFormat = PixelFormat::RGBA8888;
+
+  // 24bit 形式の展開に使用する作業領域、PcxInfo::line_size() バイト
+  // 24bit 形式で data か packed を渡す場合は必須で、不足している場合は std::invalid_argument を送出する
+  std::span<std::uint8_t> line{};
+};
+
+// parse_rows で展開した 1 行
+// 呼び出し元に返している間のみ有効
+struct PcxRow {
+  std::size_t y;
+  std::span<const std::uint8_t> indexes;  // パレット形式の場合のみ持つ
+  std::span<const Pcx::Pixel> data;
+};
+
+// read_pallete で読み出したパレット
+struct PcxPalleteInfo {
+  std::optional<std::array<Pcx::Pixel, 256>> pallete;  // 24bit 形式の場合は持たない
+  bool isEga;  // 末尾に 256 色パレットが無く、ヘッダーの EGA パレットを使用した場合は true
 };
 
 namespace internal {
@@ -139,6 +480,17 @@ MPCXPARSER_PACK(struct PcxHeaderMinimum {
   std::uint16_t bytesPerLine;
 });
 
+MPCXPARSER_PACK(struct PcxRGB {
+  std::uint8_t red;
+  std::uint8_t green;
+  std::uint8_t blue;
+});
+
+MPCXPARSER_PACK(struct PcxPallete {
+  std::uint8_t marker;
+  PcxRGB pal[256];
+});
+
 };  // namespace internal
 
 };  // namespace pcx
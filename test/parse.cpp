@@ -26,6 +26,8 @@
 #include <bit>
 #include <fstream>
 #include <ios>
+#include <iterator>
+#include <sstream>
 #include <string_view>
 
 using namespace std::string_view_literals;
@@ -527,3 +529,557 @@ TEST(test_parse, parse_from_mem_win) {
     ASSERT_TRUE(false);
   }
 }
+
+TEST(test_parse, parse_from_mem_equals_stream_win) {
+  static constexpr std::string_view pcxs[] = {
+      "assets/good/kfm.pcx"sv,
+      "assets/good/test24bits.pcx"sv,
+      "assets/good/test256.pcx"sv,
+      "assets/good/testEGA16.pcx"sv,
+      "assets/bad/missing_pallete.pcx"sv,
+      "assets/bad/missing_data.pcx"sv,
+      "assets/bad/missing_screensize.pcx"sv,
+      "assets/bad/missing_palletemode.pcx"sv,
+  };
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  for (auto&& path : pcxs) {
+    std::ifstream ifs{path.data(), std::ios_base::binary};
+    std::vector<std::uint8_t> buf{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+
+    auto expected = parser.parse(path);
+    auto actual = parser.parse(buf.data(), buf.size());
+    EXPECT_TRUE(actual == expected) << path;
+  }
+}
+
+TEST(test_parse, parse_consecutive_from_stream_win) {
+  static constexpr std::string_view kfmpcx = "assets/good/kfm.pcx"sv;
+  static constexpr std::string_view testpcx = "assets/good/test24bits.pcx"sv;
+
+  std::stringstream ss{};
+  ss << std::ifstream{kfmpcx.data(), std::ios_base::binary}.rdbuf();
+  ss << std::ifstream{testpcx.data(), std::ios_base::binary}.rdbuf();
+
+  auto parser = mugen::pcx::PcxParserWin{};
+
+  // 先読みした分はストリームに戻されるため、続けて次のPCXを読み出せる
+  auto kfm = parser.parse(ss);
+  auto test = parser.parse(ss);
+
+  EXPECT_TRUE(kfm == parser.parse(kfmpcx));
+  EXPECT_TRUE(test == parser.parse(testpcx));
+}
+
+TEST(test_parse, parse_long_runs_win) {
+  static constexpr std::size_t width = 100;
+  static constexpr std::size_t height = 2;
+
+  std::vector<std::uint8_t> buf(128, 0);
+  buf[3] = 8;
+  buf[8] = static_cast<std::uint8_t>(width - 1);
+  buf[10] = static_cast<std::uint8_t>(height - 1);
+  buf[65] = 1;
+  buf[66] = static_cast<std::uint8_t>(width);
+
+  // 1行目: 長いラン 2 つ
+  buf.insert(buf.end(), {0xC0 | 63, 0x07, 0xC0 | 37, 0xC9});
+  // 2行目: マーカーを含まないバイト列のみ
+  for (std::size_t x = 0; x < width; ++x) {
+    buf.push_back(static_cast<std::uint8_t>(x));
+  }
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  auto pcx = parser.parse(buf.data(), buf.size());
+
+  ASSERT_TRUE(pcx.indexes());
+  auto&& indexes = *(pcx.indexes());
+  for (std::size_t x = 0; x < width; ++x) {
+    EXPECT_EQ(indexes[x], x < 63 ? 0x07 : 0xC9);
+    EXPECT_EQ(indexes[width + x], x);
+  }
+}
+
+TEST(test_parse, parse_runs_over_line_end_win) {
+  static constexpr std::size_t width = 100;
+  static constexpr std::size_t height = 2;
+
+  std::vector<std::uint8_t> buf(128, 0);
+  buf[3] = 8;
+  buf[8] = static_cast<std::uint8_t>(width - 1);
+  buf[10] = static_cast<std::uint8_t>(height - 1);
+  buf[65] = 1;
+  buf[66] = static_cast<std::uint8_t>(width);
+
+  // 各行の最後のランは行末を 26 バイトはみ出すが、はみ出した分は次の行に持ち越さない
+  for (std::size_t y = 0; y < height; ++y) {
+    buf.insert(buf.end(), {0xC0 | 63, static_cast<std::uint8_t>(0x07 + y), 0xC0 | 63, static_cast<std::uint8_t>(0xC9 + y)});
+  }
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  auto pcx = parser.parse(buf.data(), buf.size());
+
+  ASSERT_TRUE(pcx.indexes());
+  auto&& indexes = *(pcx.indexes());
+  ASSERT_EQ(indexes.size(), width * height);
+  for (std::size_t y = 0; y < height; ++y) {
+    for (std::size_t x = 0; x < width; ++x) {
+      EXPECT_EQ(indexes[y * width + x], x < 63 ? 0x07 + y : 0xC9 + y);
+    }
+  }
+
+  auto region = parser.parse(buf.data(), buf.size(), mugen::pcx::PcxRegion{.x = 50, .y = 1, .width = 20});
+  ASSERT_TRUE(region.indexes());
+  for (std::size_t x = 0; x < region.width(); ++x) {
+    EXPECT_EQ((*region.indexes())[x], 50 + x < 63 ? 0x08 : 0xCA);
+  }
+}
+
+TEST(test_parse, parse_wide_24bits_win) {
+  static constexpr std::size_t width = 70;
+  static constexpr std::size_t height = 2;
+
+  std::vector<std::uint8_t> buf(128, 0);
+  buf[3] = 8;
+  buf[8] = static_cast<std::uint8_t>(width - 1);
+  buf[10] = static_cast<std::uint8_t>(height - 1);
+  buf[65] = 3;
+  buf[66] = static_cast<std::uint8_t>(width);
+
+  for (std::size_t y = 0; y < height; ++y) {
+    // R: マーカーを含まないバイト列、G: ラン、B: ランとバイト列の混在
+    for (std::size_t x = 0; x < width; ++x) {
+      buf.push_back(static_cast<std::uint8_t>(x + y));
+    }
+    buf.insert(buf.end(), {0xC0 | 40, 0xD0, 0xC0 | 30, static_cast<std::uint8_t>(0x10 + y)});
+    buf.insert(buf.end(), {0xC0 | 60, 0x20});
+    for (std::size_t x = 60; x < width; ++x) {
+      buf.push_back(static_cast<std::uint8_t>(x));
+    }
+  }
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  auto pcx = parser.parse(buf.data(), buf.size());
+
+  ASSERT_EQ(pcx.data().size(), width * height);
+  for (std::size_t y = 0; y < height; ++y) {
+    for (std::size_t x = 0; x < width; ++x) {
+      auto&& pixel = pcx.data()[y * width + x];
+      EXPECT_EQ(pixel.red, x + y);
+      EXPECT_EQ(pixel.green, x < 40 ? 0xD0 : 0x10 + y);
+      EXPECT_EQ(pixel.blue, x < 60 ? 0x20 : x);
+      EXPECT_EQ(pixel.alpha, 255);
+    }
+  }
+}
+
+TEST(test_parse, parse_planar_short_lines_win) {
+  static constexpr std::size_t width = 8;
+  static constexpr std::size_t height = 2;
+  static constexpr std::size_t bytesPerLine = 5;
+
+  std::vector<std::uint8_t> buf(128, 0);
+  buf[3] = 8;
+  buf[8] = static_cast<std::uint8_t>(width - 1);
+  buf[10] = static_cast<std::uint8_t>(height - 1);
+  buf[65] = 3;
+  buf[66] = static_cast<std::uint8_t>(bytesPerLine);
+
+  // B プレーンの最後のランは行末をはみ出す
+  for (std::size_t y = 0; y < height; ++y) {
+    buf.insert(buf.end(), {0xC0 | 5, static_cast<std::uint8_t>(0x10 + y), 0xC0 | 5, static_cast<std::uint8_t>(0x20 + y)});
+    buf.insert(buf.end(), {0xC0 | 7, static_cast<std::uint8_t>(0x30 + y)});
+  }
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  auto planar = mugen::pcx::PcxParserWin{mugen::pcx::ParseOptions{.pixelLayout = mugen::pcx::PixelLayout::Planar}};
+
+  auto expected = parser.parse(buf.data(), buf.size());
+  auto pcx = planar.parse(buf.data(), buf.size());
+  EXPECT_TRUE(pcx == expected);
+
+  const auto& planes = pcx.planes();
+  ASSERT_EQ(planes.red.size(), width * height);
+  for (std::size_t x = 0; x < width; ++x) {
+    EXPECT_EQ(planes.red[x], x < bytesPerLine ? 0x10 : 0);
+    EXPECT_EQ(planes.blue[x], x < 7 ? 0x30 : 0);
+    EXPECT_EQ(planes.alpha[x], 255);
+  }
+
+  auto region = mugen::pcx::PcxRegion{.x = 3, .y = 1, .width = 4};
+  EXPECT_TRUE(planar.parse(buf.data(), buf.size(), region) == parser.parse(buf.data(), buf.size(), region));
+}
+
+TEST(test_parse, parse_into_win) {
+  static constexpr std::string_view pcxs[] = {
+      "assets/good/kfm.pcx"sv,
+      "assets/good/test24bits.pcx"sv,
+      "assets/good/test256.pcx"sv,
+      "assets/good/testEGA16.pcx"sv,
+      "assets/bad/missing_data.pcx"sv,
+  };
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  for (auto&& path : pcxs) {
+    std::ifstream ifs{path.data(), std::ios_base::binary};
+    std::vector<std::uint8_t> buf{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+
+    auto expected = parser.parse(path);
+
+    auto info = parser.probe(buf.data(), buf.size());
+    EXPECT_EQ(info.width, expected.width()) << path;
+    EXPECT_EQ(info.height, expected.height()) << path;
+    EXPECT_EQ(info.bytesPerLine, expected.bytes_per_line()) << path;
+    EXPECT_EQ(info.colorPlanes, expected.indexes() ? 1 : 3) << path;
+
+    std::vector<std::uint8_t> indexes(info.size());
+    std::array<mugen::pcx::Pcx::Pixel, 256> pallete{};
+    std::vector<mugen::pcx::Pcx::Pixel> data(info.size());
+    std::vector<std::uint8_t> line(info.line_size());
+
+    parser.parse_into(buf.data(), buf.size(), mugen::pcx::PcxBuffers{.indexes = indexes, .pallete = pallete, .data = data, .line = line});
+    EXPECT_EQ(data, expected.data()) << path;
+    if (expected.indexes() && expected.pallete()) {
+      EXPECT_EQ(indexes, *(expected.indexes())) << path;
+      EXPECT_EQ(pallete, *(expected.pallete())) << path;
+    }
+
+    // インデックスの展開先を渡さない場合でも同じ結果となる
+    std::vector<mugen::pcx::Pcx::Pixel> dataOnly(info.size());
+    parser.parse_into(buf.data(), buf.size(), mugen::pcx::PcxBuffers{.data = dataOnly, .line = line});
+    EXPECT_EQ(dataOnly, expected.data()) << path;
+
+    // 指定した並びの std::uint32_t にも、data と併せて、または単独で書き込める
+    static constexpr mugen::pcx::PixelFormat formats[] = {
+        mugen::pcx::PixelFormat::RGBA8888,
+        mugen::pcx::PixelFormat::BGRA8888,
+        mugen::pcx::PixelFormat::ARGB8888,
+    };
+    for (auto format : formats) {
+      std::vector<std::uint32_t> packed(info.size());
+      expected.pack(format, packed);
+
+      std::vector<std::uint32_t> withData(info.size());
+      parser.parse_into(buf.data(), buf.size(), mugen::pcx::PcxBuffers{.data = dataOnly, .packed = withData, .packedFormat = format, .line = line});
+      EXPECT_EQ(withData, packed) << path;
+
+      std::vector<std::uint32_t> packedOnly(info.size());
+      parser.parse_into(buf.data(), buf.size(), mugen::pcx::PcxBuffers{.packed = packedOnly, .packedFormat = format, .line = line});
+      EXPECT_EQ(packedOnly, packed) << path;
+    }
+  }
+
+  std::vector<std::uint8_t> small(1);
+  std::ifstream ifs{"assets/good/kfm.pcx", std::ios_base::binary};
+  std::vector<std::uint8_t> buf{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+  EXPECT_THROW(parser.parse_into(buf.data(), buf.size(), mugen::pcx::PcxBuffers{.indexes = small}), std::invalid_argument);
+
+  // 24bit 形式では作業領域を確保せず、不足している場合は送出する
+  std::ifstream ifs24{"assets/good/test24bits.pcx", std::ios_base::binary};
+  std::vector<std::uint8_t> buf24{std::istreambuf_iterator<char>{ifs24}, std::istreambuf_iterator<char>{}};
+  auto info24 = parser.probe(buf24.data(), buf24.size());
+  std::vector<mugen::pcx::Pcx::Pixel> data24(info24.size());
+  std::vector<std::uint8_t> shortLine(info24.line_size() - 1);
+  EXPECT_THROW(parser.parse_into(buf24.data(), buf24.size(), mugen::pcx::PcxBuffers{.data = data24}), std::invalid_argument);
+  EXPECT_THROW(parser.parse_into(buf24.data(), buf24.size(), mugen::pcx::PcxBuffers{.data = data24, .line = shortLine}),
+               std::invalid_argument);
+}
+
+TEST(test_parse, probe_win) {
+  static constexpr std::string_view pcxs[] = {
+      "assets/good/kfm.pcx"sv,
+      "assets/good/test24bits.pcx"sv,
+      "assets/good/test256.pcx"sv,
+      "assets/good/testEGA16.pcx"sv,
+  };
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  for (auto&& path : pcxs) {
+    auto expected = parser.parse(path);
+
+    auto info = parser.probe(path);
+    EXPECT_EQ(info.width, expected.width()) << path;
+    EXPECT_EQ(info.height, expected.height()) << path;
+    EXPECT_EQ(info.bytesPerLine, expected.bytes_per_line()) << path;
+    EXPECT_EQ(info.colorPlanes, expected.indexes() ? 1 : 3) << path;
+
+    // ストリームの位置は元に戻るため、続けて parse できる
+    std::ifstream ifs{path.data(), std::ios_base::binary};
+    auto streamInfo = parser.probe(ifs);
+    EXPECT_EQ(streamInfo.width, info.width) << path;
+    EXPECT_EQ(streamInfo.height, info.height) << path;
+    EXPECT_TRUE(parser.parse(ifs) == expected) << path;
+  }
+
+  EXPECT_THROW(parser.probe(NOT_EXISTING_FILE), mugen::pcx::FileIOError);
+  EXPECT_THROW(parser.probe("assets/bad/missing_bytesperline.pcx"sv), mugen::pcx::IllegalFormatError);
+  EXPECT_THROW(parser.probe("assets/bad/kfm16.pcx"sv), mugen::pcx::IncompatibleFormatError);
+  EXPECT_THROW(parser.probe("assets/bad/test32bits.pcx"sv), mugen::pcx::IncompatibleFormatError);
+  EXPECT_THROW(parser.probe("assets/bad/zero.pcx"sv), mugen::pcx::IncompatibleFormatError);
+}
+
+TEST(test_parse, read_pallete_win) {
+  static constexpr std::string_view pcxs[] = {
+      "assets/good/kfm.pcx"sv,
+      "assets/good/test24bits.pcx"sv,
+      "assets/good/test256.pcx"sv,
+      "assets/good/testEGA16.pcx"sv,
+  };
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  for (auto&& path : pcxs) {
+    auto expected = parser.parse(path);
+
+    auto info = parser.read_pallete(path);
+    EXPECT_EQ(info.pallete, expected.pallete()) << path;
+
+    std::ifstream ifs{path.data(), std::ios_base::binary};
+    std::vector<std::uint8_t> buf{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+    auto memInfo = parser.read_pallete(buf.data(), buf.size());
+    EXPECT_EQ(memInfo.pallete, expected.pallete()) << path;
+    EXPECT_EQ(memInfo.isEga, info.isEga) << path;
+
+    // ストリームの位置は元に戻るため、続けて parse できる
+    ifs.clear();
+    ifs.seekg(0);
+    auto streamInfo = parser.read_pallete(ifs);
+    EXPECT_EQ(streamInfo.pallete, expected.pallete()) << path;
+    EXPECT_TRUE(parser.parse(ifs) == expected) << path;
+  }
+
+  EXPECT_FALSE(parser.read_pallete("assets/good/kfm.pcx"sv).isEga);
+  EXPECT_TRUE(parser.read_pallete("assets/good/testEGA16.pcx"sv).isEga);
+  EXPECT_FALSE(parser.read_pallete("assets/good/test24bits.pcx"sv).pallete);
+
+  EXPECT_THROW(parser.read_pallete(NOT_EXISTING_FILE), mugen::pcx::FileIOError);
+  EXPECT_THROW(parser.read_pallete("assets/bad/missing_bytesperline.pcx"sv), mugen::pcx::IllegalFormatError);
+  EXPECT_THROW(parser.read_pallete("assets/bad/kfm16.pcx"sv), mugen::pcx::IncompatibleFormatError);
+}
+
+TEST(test_parse, parse_region_win) {
+  static constexpr std::string_view pcxs[] = {
+      "assets/good/kfm.pcx"sv,
+      "assets/good/test24bits.pcx"sv,
+      "assets/good/test256.pcx"sv,
+      "assets/good/testEGA16.pcx"sv,
+  };
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  auto planar = mugen::pcx::PcxParserWin{mugen::pcx::ParseOptions{.pixelLayout = mugen::pcx::PixelLayout::Planar}};
+  for (auto&& path : pcxs) {
+    std::ifstream ifs{path.data(), std::ios_base::binary};
+    std::vector<std::uint8_t> buf{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+
+    auto expected = parser.parse(path);
+    EXPECT_TRUE(parser.parse(path, mugen::pcx::PcxRegion{}) == expected) << path;
+    EXPECT_TRUE(parser.parse(buf.data(), buf.size(), mugen::pcx::PcxRegion{}) == expected) << path;
+
+    auto w = expected.width();
+    auto h = expected.height();
+    const mugen::pcx::PcxRegion regions[] = {
+        {.x = 0, .y = 0, .width = w, .height = 1},
+        {.x = 0, .y = h / 2, .width = w, .height = h / 3 + 1},
+        {.x = w / 3, .y = h / 4, .width = w / 2 + 1, .height = h / 2 + 1},
+        {.x = w - 1, .y = h - 1},
+    };
+    for (auto&& region : regions) {
+      auto pcx = parser.parse(buf.data(), buf.size(), region);
+      ASSERT_EQ(pcx.width(), std::min(region.width, w - region.x)) << path;
+      ASSERT_EQ(pcx.height(), std::min(region.height, h - region.y)) << path;
+      EXPECT_EQ(pcx.pallete(), expected.pallete()) << path;
+
+      for (std::size_t y = 0; y < pcx.height(); ++y) {
+        for (std::size_t x = 0; x < pcx.width(); ++x) {
+          auto index = (region.y + y) * w + region.x + x;
+          EXPECT_EQ(pcx.data()[y * pcx.width() + x], expected.data()[index]) << path;
+          if (pcx.indexes()) {
+            EXPECT_EQ((*pcx.indexes())[y * pcx.width() + x], (*expected.indexes())[index]) << path;
+          }
+        }
+      }
+
+      EXPECT_TRUE(parser.parse(path, region) == pcx) << path;
+      EXPECT_TRUE(planar.parse(buf.data(), buf.size(), region) == pcx) << path;
+    }
+
+    EXPECT_THROW(parser.parse(buf.data(), buf.size(), mugen::pcx::PcxRegion{.x = w}), std::invalid_argument) << path;
+    EXPECT_THROW(parser.parse(buf.data(), buf.size(), mugen::pcx::PcxRegion{.y = h}), std::invalid_argument) << path;
+    EXPECT_THROW(parser.parse(buf.data(), buf.size(), mugen::pcx::PcxRegion{.height = 0}), std::invalid_argument) << path;
+  }
+
+  EXPECT_THROW(parser.parse(NOT_EXISTING_FILE, mugen::pcx::PcxRegion{}), mugen::pcx::FileIOError);
+}
+
+TEST(test_parse, decoder_win) {
+  static constexpr std::string_view pcxs[] = {
+      "assets/good/kfm.pcx"sv,
+      "assets/good/test24bits.pcx"sv,
+      "assets/good/test256.pcx"sv,
+      "assets/good/testEGA16.pcx"sv,
+      "assets/bad/missing_data.pcx"sv,
+      "assets/bad/missing_pallete.pcx"sv,
+      "assets/bad/missing_screensize.pcx"sv,
+  };
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  for (auto&& path : pcxs) {
+    std::ifstream ifs{path.data(), std::ios_base::binary};
+    std::vector<std::uint8_t> buf{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+
+    auto expected = parser.parse(path);
+
+    // ランの長さと値の間で分断される場合を含め、どの大きさに分割しても同じ結果となる
+    for (std::size_t chunkSize : {1, 2, 3, 7, 64, 1000}) {
+      std::vector<std::uint8_t> indexes;
+      std::vector<mugen::pcx::Pcx::Pixel> data;
+      std::size_t rows = 0;
+
+      auto decoder = mugen::pcx::PcxDecoderWin{[&](std::size_t y, auto rowIndexes, auto rowData) {
+        EXPECT_EQ(y, rows++) << path;
+        indexes.insert(indexes.end(), rowIndexes.begin(), rowIndexes.end());
+        data.insert(data.end(), rowData.begin(), rowData.end());
+      }};
+      for (std::size_t i = 0; i < buf.size(); i += chunkSize) {
+        decoder.feed(std::span{buf}.subspan(i, std::min(chunkSize, buf.size() - i)));
+      }
+      auto pallete = decoder.finish();
+
+      ASSERT_TRUE(decoder.info()) << path;
+      EXPECT_EQ(decoder.info()->width, expected.width()) << path;
+      EXPECT_EQ(rows, expected.height()) << path;
+      EXPECT_EQ(pallete.pallete, expected.pallete()) << path;
+      if (expected.indexes()) {
+        EXPECT_EQ(indexes, *(expected.indexes())) << path << " " << chunkSize;
+      } else {
+        EXPECT_EQ(data, expected.data()) << path << " " << chunkSize;
+      }
+    }
+
+    // 途中で終端に達した場合も parse と同じ結果となる
+    for (auto length : {buf.size() / 2, buf.size() - 1}) {
+      if (length <= 128) {
+        continue;
+      }
+      auto truncated = parser.parse(buf.data(), length);
+
+      std::vector<std::uint8_t> indexes;
+      std::vector<mugen::pcx::Pcx::Pixel> data;
+      auto decoder = mugen::pcx::PcxDecoderWin{[&](std::size_t, auto rowIndexes, auto rowData) {
+        indexes.insert(indexes.end(), rowIndexes.begin(), rowIndexes.end());
+        data.insert(data.end(), rowData.begin(), rowData.end());
+      }};
+      decoder.feed(std::span{buf}.first(length));
+      EXPECT_EQ(decoder.finish().pallete, truncated.pallete()) << path;
+      if (truncated.indexes()) {
+        EXPECT_EQ(indexes, *(truncated.indexes())) << path;
+      } else {
+        EXPECT_EQ(data, truncated.data()) << path;
+      }
+    }
+  }
+
+  auto decoder = mugen::pcx::PcxDecoderWin{[](std::size_t, auto, auto) {}};
+  std::ifstream ifs{"assets/bad/kfm16.pcx", std::ios_base::binary};
+  std::vector<std::uint8_t> buf{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+  EXPECT_THROW(decoder.feed(buf), mugen::pcx::IncompatibleFormatError);
+
+  auto small = mugen::pcx::PcxDecoderWin{[](std::size_t, auto, auto) {}};
+  small.feed(std::span{buf}.first(16));
+  EXPECT_THROW(small.finish(), mugen::pcx::IllegalFormatError);
+}
+
+TEST(test_parse, parse_rows_win) {
+  static constexpr std::string_view pcxs[] = {
+      "assets/good/kfm.pcx"sv,
+      "assets/good/test24bits.pcx"sv,
+      "assets/good/test256.pcx"sv,
+      "assets/good/testEGA16.pcx"sv,
+      "assets/bad/missing_data.pcx"sv,
+  };
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  auto indexesOnly = mugen::pcx::PcxParserWin{mugen::pcx::ParseOptions{.dataExpansion = mugen::pcx::DataExpansion::None}};
+  for (auto&& path : pcxs) {
+    std::ifstream ifs{path.data(), std::ios_base::binary};
+    std::vector<std::uint8_t> buf{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+
+    auto expected = parser.parse(path);
+
+    std::vector<std::uint8_t> indexes;
+    std::vector<mugen::pcx::Pcx::Pixel> data;
+    std::size_t rows = 0;
+    auto onRow = [&](const mugen::pcx::PcxRow& row) {
+      EXPECT_EQ(row.y, rows++) << path;
+      EXPECT_EQ(row.data.size(), expected.width()) << path;
+      indexes.insert(indexes.end(), row.indexes.begin(), row.indexes.end());
+      data.insert(data.end(), row.data.begin(), row.data.end());
+    };
+
+    parser.parse_rows(path, onRow);
+    EXPECT_EQ(rows, expected.height()) << path;
+    EXPECT_EQ(data, expected.data()) << path;
+    if (expected.indexes()) {
+      EXPECT_EQ(indexes, *(expected.indexes())) << path;
+    } else {
+      EXPECT_TRUE(indexes.empty()) << path;
+    }
+
+    indexes.clear();
+    data.clear();
+    rows = 0;
+    parser.parse_rows(buf.data(), buf.size(), onRow);
+    EXPECT_EQ(data, expected.data()) << path;
+
+    // パレット形式の場合、RGBA 形式には展開しない
+    if (expected.indexes()) {
+      indexes.clear();
+      indexesOnly.parse_rows(std::span{buf}, [&](const mugen::pcx::PcxRow& row) {
+        EXPECT_TRUE(row.data.empty()) << path;
+        indexes.insert(indexes.end(), row.indexes.begin(), row.indexes.end());
+      });
+      EXPECT_EQ(indexes, *(expected.indexes())) << path;
+    }
+  }
+
+  auto ignore = [](const mugen::pcx::PcxRow&) {};
+  EXPECT_THROW(parser.parse_rows(NOT_EXISTING_FILE, ignore), mugen::pcx::FileIOError);
+  EXPECT_THROW(parser.parse_rows("assets/bad/missing_bytesperline.pcx"sv, ignore), mugen::pcx::IllegalFormatError);
+  EXPECT_THROW(parser.parse_rows("assets/bad/kfm16.pcx"sv, ignore), mugen::pcx::IncompatibleFormatError);
+}
+
+TEST(test_parse, try_parse_win) {
+  static constexpr std::string_view pcxs[] = {
+      "assets/good/kfm.pcx"sv,
+      "assets/good/test24bits.pcx"sv,
+      "assets/bad/missing_data.pcx"sv,
+  };
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  for (auto&& path : pcxs) {
+    auto expected = parser.parse(path);
+
+    auto result = parser.try_parse(path);
+    ASSERT_TRUE(result) << path;
+    EXPECT_EQ(result.error, mugen::pcx::ErrorCode::None) << path;
+    EXPECT_TRUE(result.pcx == expected) << path;
+
+    std::ifstream ifs{path.data(), std::ios_base::binary};
+    auto streamResult = parser.try_parse(ifs);
+    ASSERT_TRUE(streamResult) << path;
+    EXPECT_TRUE(streamResult.pcx == expected) << path;
+  }
+
+  // 例外クラスと同じ種類のエラーを返す
+  EXPECT_EQ(parser.try_parse(NOT_EXISTING_FILE).error, mugen::pcx::ErrorCode::FileIOError);
+  EXPECT_EQ(parser.try_parse("assets/bad/missing_bytesperline.pcx"sv).error, mugen::pcx::ErrorCode::IllegalFormatError);
+  EXPECT_EQ(parser.try_parse("assets/bad/kfm16.pcx"sv).error, mugen::pcx::ErrorCode::IncompatibleFormatError);
+  EXPECT_EQ(parser.try_parse("assets/bad/test32bits.pcx"sv).error, mugen::pcx::ErrorCode::IncompatibleFormatError);
+  EXPECT_EQ(parser.try_parse("assets/bad/zero.pcx"sv).error, mugen::pcx::ErrorCode::IncompatibleFormatError);
+
+  std::vector<std::uint8_t> small(16);
+  auto result = parser.try_parse(small.data(), small.size());
+  EXPECT_FALSE(result);
+  EXPECT_FALSE(result.pcx);
+  EXPECT_EQ(result.error, mugen::pcx::ErrorCode::IllegalFormatError);
+  EXPECT_EQ(parser.try_parse(std::span{small}).error, mugen::pcx::ErrorCode::IllegalFormatError);
+}
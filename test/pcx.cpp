@@ -0,0 +1,437 @@
+/**
+ * @file pcx.cpp
+ * @author Halkaze
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include <mpcxparser/mpcxparser.h>
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std::string_view_literals;
+
+// ヒープ確保の回数を数えるため、グローバルな operator new / operator delete を一式置き換える
+// 確保と解放の組み合わせが揃うよう、配列形式・アライメント指定・nothrow 形式もすべて同じ関数を通す
+static std::atomic<std::size_t> allocations{0};
+
+static void* counted_alloc(std::size_t size, std::size_t alignment) noexcept {
+  ++allocations;
+  if (size == 0) {
+    size = 1;
+  }
+  if (alignment <= alignof(std::max_align_t)) {
+    return std::malloc(size);
+  }
+#if defined(_MSC_VER)
+  return _aligned_malloc(size, alignment);
+#else
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+static void counted_free(void* p, std::size_t alignment) noexcept {
+#if defined(_MSC_VER)
+  if (alignment > alignof(std::max_align_t)) {
+    _aligned_free(p);
+    return;
+  }
+#else
+  static_cast<void>(alignment);
+#endif
+  std::free(p);
+}
+
+static void* counted_new(std::size_t size, std::size_t alignment) {
+  if (auto p = counted_alloc(size, alignment)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+static constexpr std::size_t DEFAULT_ALIGNMENT = alignof(std::max_align_t);
+
+void* operator new(std::size_t size) {
+  return counted_new(size, DEFAULT_ALIGNMENT);
+}
+void* operator new[](std::size_t size) {
+  return counted_new(size, DEFAULT_ALIGNMENT);
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return counted_new(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return counted_new(size, static_cast<std::size_t>(alignment));
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return counted_alloc(size, DEFAULT_ALIGNMENT);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return counted_alloc(size, DEFAULT_ALIGNMENT);
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept {
+  counted_free(p, DEFAULT_ALIGNMENT);
+}
+void operator delete[](void* p) noexcept {
+  counted_free(p, DEFAULT_ALIGNMENT);
+}
+void operator delete(void* p, std::size_t) noexcept {
+  counted_free(p, DEFAULT_ALIGNMENT);
+}
+void operator delete[](void* p, std::size_t) noexcept {
+  counted_free(p, DEFAULT_ALIGNMENT);
+}
+void operator delete(void* p, std::align_val_t alignment) noexcept {
+  counted_free(p, static_cast<std::size_t>(alignment));
+}
+void operator delete[](void* p, std::align_val_t alignment) noexcept {
+  counted_free(p, static_cast<std::size_t>(alignment));
+}
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept {
+  counted_free(p, static_cast<std::size_t>(alignment));
+}
+void operator delete[](void* p, std::size_t, std::align_val_t alignment) noexcept {
+  counted_free(p, static_cast<std::size_t>(alignment));
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  counted_free(p, DEFAULT_ALIGNMENT);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  counted_free(p, DEFAULT_ALIGNMENT);
+}
+void operator delete(void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  counted_free(p, static_cast<std::size_t>(alignment));
+}
+void operator delete[](void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  counted_free(p, static_cast<std::size_t>(alignment));
+}
+
+TEST(test_pcx, lazy_expansion) {
+  static constexpr std::string_view kfmpcx = "assets/good/kfm.pcx"sv;
+
+  auto eager = mugen::pcx::PcxParserWin{mugen::pcx::ParseOptions{.dataExpansion = mugen::pcx::DataExpansion::Eager}}.parse(kfmpcx);
+  auto lazy = mugen::pcx::PcxParserWin{}.parse(kfmpcx);
+
+  // 複数のスレッドから同時に呼び出しても、展開は一度だけ行われる
+  std::vector<const std::vector<mugen::pcx::Pcx::Pixel>*> results(8);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    threads.emplace_back([&lazy, &results, i]() { results[i] = &lazy.data(); });
+  }
+  for (auto&& thread : threads) {
+    thread.join();
+  }
+  for (auto&& result : results) {
+    EXPECT_EQ(result, &lazy.data());
+  }
+
+  EXPECT_EQ(lazy.data(), eager.data());
+  EXPECT_TRUE(lazy == eager);
+}
+
+TEST(test_pcx, no_expansion) {
+  static constexpr std::string_view kfmpcx = "assets/good/kfm.pcx"sv;
+  static constexpr std::string_view testpcx = "assets/good/test24bits.pcx"sv;
+
+  auto parser = mugen::pcx::PcxParserWin{mugen::pcx::ParseOptions{.dataExpansion = mugen::pcx::DataExpansion::None}};
+
+  auto pcx = parser.parse(kfmpcx);
+  EXPECT_TRUE(pcx.pallete());
+  EXPECT_TRUE(pcx.indexes());
+  EXPECT_TRUE(pcx.data().empty());
+
+  // パレット形式どうしの比較では data() を展開しない
+  auto lazy = mugen::pcx::PcxParserWin{}.parse(kfmpcx);
+  auto before = allocations.load();
+  EXPECT_TRUE(pcx == lazy);
+  EXPECT_TRUE((pcx <=> lazy) == 0);
+  EXPECT_EQ(allocations.load() - before, 0);
+
+  // パレットを持たないPCXは常にRGBA形式のデータを持つ
+  auto test = parser.parse(testpcx);
+  EXPECT_EQ(test.data().size(), test.width() * test.height());
+}
+
+TEST(test_pcx, planar_layout) {
+  static constexpr std::string_view pcxs[] = {"assets/good/kfm.pcx"sv, "assets/good/test24bits.pcx"sv};
+
+  auto interleaved = mugen::pcx::PcxParserWin{};
+  auto planar = mugen::pcx::PcxParserWin{mugen::pcx::ParseOptions{.pixelLayout = mugen::pcx::PixelLayout::Planar}};
+  auto eager = mugen::pcx::PcxParserWin{
+      mugen::pcx::ParseOptions{.dataExpansion = mugen::pcx::DataExpansion::Eager, .pixelLayout = mugen::pcx::PixelLayout::Planar}};
+  for (auto&& path : pcxs) {
+    auto expected = interleaved.parse(path);
+    const auto& data = expected.data();
+
+    // どちらの形式で構築しても、もう一方は同じ内容に展開される
+    for (auto&& pcx : {planar.parse(path), eager.parse(path), interleaved.parse(path)}) {
+      const auto& planes = pcx.planes();
+      ASSERT_EQ(planes.red.size(), data.size()) << path;
+      ASSERT_EQ(planes.green.size(), data.size()) << path;
+      ASSERT_EQ(planes.blue.size(), data.size()) << path;
+      ASSERT_EQ(planes.alpha.size(), data.size()) << path;
+      for (std::size_t i = 0; i < data.size(); ++i) {
+        EXPECT_EQ(planes.red[i], data[i].red) << path;
+        EXPECT_EQ(planes.green[i], data[i].green) << path;
+        EXPECT_EQ(planes.blue[i], data[i].blue) << path;
+        EXPECT_EQ(planes.alpha[i], data[i].alpha) << path;
+      }
+      EXPECT_TRUE(pcx == expected) << path;
+      EXPECT_EQ(&pcx.planes(), &planes) << path;
+    }
+  }
+
+  // DataExpansion::None の場合はどちらも空となる
+  auto none = mugen::pcx::PcxParserWin{
+      mugen::pcx::ParseOptions{.dataExpansion = mugen::pcx::DataExpansion::None, .pixelLayout = mugen::pcx::PixelLayout::Planar}};
+  auto pcx = none.parse(pcxs[0]);
+  EXPECT_TRUE(pcx.planes().alpha.empty());
+  EXPECT_TRUE(pcx.data().empty());
+}
+
+TEST(test_pcx, expand_indexes) {
+  static constexpr std::string_view kfmpcx = "assets/good/kfm.pcx"sv;
+
+  auto pcx = mugen::pcx::PcxParserWin{}.parse(kfmpcx);
+  const auto& indexes = *(pcx.indexes());
+
+  std::vector<mugen::pcx::Pcx::Pixel> data(indexes.size());
+  mugen::pcx::Pcx::expand_indexes(indexes, *(pcx.pallete()), data);
+  EXPECT_EQ(data, pcx.data());
+
+  // 別のパレットで展開する
+  std::array<mugen::pcx::Pcx::Pixel, 256> pallete{};
+  for (std::size_t i = 0; i < pallete.size(); ++i) {
+    pallete[i].red = static_cast<std::uint8_t>(255 - i);
+    pallete[i].green = static_cast<std::uint8_t>(i);
+    pallete[i].blue = static_cast<std::uint8_t>(i * 3);
+    pallete[i].alpha = static_cast<std::uint8_t>(i / 2);
+  }
+
+  // 端数の要素数でも同じ結果となる
+  for (std::size_t n : {std::size_t{0}, std::size_t{1}, std::size_t{13}, indexes.size()}) {
+    std::vector<mugen::pcx::Pcx::Pixel> other(n);
+    mugen::pcx::Pcx::expand_indexes(std::span{indexes}.first(n), pallete, other);
+    for (std::size_t i = 0; i < n; ++i) {
+      ASSERT_EQ(other[i], pallete[indexes[i]]) << i;
+    }
+  }
+
+  std::vector<mugen::pcx::Pcx::Pixel> small(indexes.size() - 1);
+  EXPECT_THROW(mugen::pcx::Pcx::expand_indexes(indexes, pallete, small), std::invalid_argument);
+}
+
+TEST(test_pcx, data_with_other_pallete) {
+  static constexpr std::string_view kfmpcx = "assets/good/kfm.pcx"sv;
+  static constexpr std::string_view testpcx = "assets/good/test24bits.pcx"sv;
+
+  std::array<mugen::pcx::Pcx::Pixel, 256> pallete{};
+  for (std::size_t i = 0; i < pallete.size(); ++i) {
+    pallete[i].red = static_cast<std::uint8_t>(i);
+    pallete[i].green = static_cast<std::uint8_t>(255 - i);
+  }
+
+  auto parser = mugen::pcx::PcxParserWin{mugen::pcx::ParseOptions{.dataExpansion = mugen::pcx::DataExpansion::None}};
+  auto pcx = parser.parse(kfmpcx);
+
+  // 元の Pcx はそのまま残る
+  auto before = *(pcx.pallete());
+  auto skinned = mugen::pcx::Pcx{pcx.width(), pcx.height(), pcx.bytes_per_line(), std::array{pallete}, std::vector{*(pcx.indexes())}};
+  EXPECT_EQ(pcx.data_with(pallete), skinned.data());
+  EXPECT_EQ(*(pcx.pallete()), before);
+  EXPECT_TRUE(pcx.data().empty());
+
+  // 呼び出し元のバッファに展開する場合は確保が発生しない
+  std::vector<mugen::pcx::Pcx::Pixel> data(pcx.width() * pcx.height());
+  auto count = allocations.load();
+  pcx.data_with(pallete, data);
+  EXPECT_EQ(allocations.load() - count, 0);
+  EXPECT_EQ(data, skinned.data());
+
+  std::vector<std::uint32_t> packed(data.size());
+  std::vector<std::uint32_t> expected(data.size());
+  pcx.pack(mugen::pcx::PixelFormat::BGRA8888, pallete, packed);
+  skinned.pack(mugen::pcx::PixelFormat::BGRA8888, expected);
+  EXPECT_EQ(packed, expected);
+
+  std::vector<mugen::pcx::Pcx::Pixel> small(data.size() - 1);
+  EXPECT_THROW(pcx.data_with(pallete, small), std::invalid_argument);
+
+  // 24bit 形式ではパレットを使用しない
+  auto test = parser.parse(testpcx);
+  EXPECT_EQ(test.data_with(pallete), test.data());
+}
+
+TEST(test_pcx, pack) {
+  static constexpr std::string_view pcxs[] = {"assets/good/kfm.pcx"sv, "assets/good/test24bits.pcx"sv};
+
+  // メモリ上のバイトの並び
+  static constexpr std::pair<mugen::pcx::PixelFormat, std::array<std::size_t, 4>> formats[] = {
+      {mugen::pcx::PixelFormat::RGBA8888, {0, 1, 2, 3}},
+      {mugen::pcx::PixelFormat::BGRA8888, {2, 1, 0, 3}},
+      {mugen::pcx::PixelFormat::ARGB8888, {3, 0, 1, 2}},
+  };
+
+  auto none = mugen::pcx::PcxParserWin{mugen::pcx::ParseOptions{.dataExpansion = mugen::pcx::DataExpansion::None}};
+  for (auto&& path : pcxs) {
+    auto pcx = mugen::pcx::PcxParserWin{}.parse(path);
+    const auto& data = pcx.data();
+
+    for (auto&& [format, order] : formats) {
+      std::vector<std::uint32_t> packed(data.size());
+      pcx.pack(format, packed);
+      for (std::size_t i = 0; i < data.size(); ++i) {
+        std::uint8_t rgba[] = {data[i].red, data[i].green, data[i].blue, data[i].alpha};
+        auto bytes = std::bit_cast<std::array<std::uint8_t, 4>>(packed[i]);
+        for (std::size_t c = 0; c < 4; ++c) {
+          ASSERT_EQ(bytes[c], rgba[order[c]]) << path << " " << i;
+        }
+      }
+
+      // data() を展開していなくてもインデックスから書き込める
+      std::vector<std::uint32_t> fromIndexes(data.size());
+      none.parse(path).pack(format, fromIndexes);
+      EXPECT_EQ(fromIndexes, packed) << path;
+    }
+
+    std::vector<std::uint32_t> small(data.size() - 1);
+    EXPECT_THROW(pcx.pack(mugen::pcx::PixelFormat::RGBA8888, small), std::invalid_argument) << path;
+  }
+}
+
+TEST(test_pcx, shared_pallete) {
+  static constexpr std::string_view pcxs[] = {"assets/good/kfm.pcx"sv, "assets/good/test256.pcx"sv, "assets/good/test24bits.pcx"sv};
+
+  auto cache = std::make_shared<mugen::pcx::PalleteCache>();
+  auto parser = mugen::pcx::PcxParserWin{mugen::pcx::ParseOptions{.palleteCache = cache}};
+  auto plain = mugen::pcx::PcxParserWin{};
+
+  for (auto&& path : pcxs) {
+    auto expected = plain.parse(path);
+    auto first = parser.parse(path);
+    auto second = parser.parse(path);
+
+    EXPECT_TRUE(first == expected) << path;
+    EXPECT_EQ(first.shared_pallete(), second.shared_pallete()) << path;
+    EXPECT_EQ(static_cast<bool>(first.shared_pallete()), static_cast<bool>(expected.pallete())) << path;
+    if (expected.pallete()) {
+      // キャッシュを使用しない場合は共有しない
+      EXPECT_NE(plain.parse(path).shared_pallete(), expected.shared_pallete()) << path;
+    }
+  }
+  EXPECT_EQ(cache->size(), 2);
+
+  // キャッシュ済みのパレットは確保せずに共有する（インデックス の1回）
+  std::ifstream ifs{pcxs[0].data(), std::ios_base::binary};
+  std::vector<std::uint8_t> buf{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+  auto before = allocations.load();
+  auto pcx = parser.parse(buf.data(), buf.size());
+  EXPECT_EQ(allocations.load() - before, 1);
+
+  // 複製した Pcx もパレットを共有する
+  auto copy = pcx;
+  EXPECT_EQ(copy.shared_pallete(), pcx.shared_pallete());
+
+  // 手放した後も使用中のパレットは有効
+  cache->clear();
+  EXPECT_EQ(cache->size(), 0);
+  EXPECT_TRUE(pcx.pallete());
+  EXPECT_NE(parser.parse(buf.data(), buf.size()).shared_pallete(), pcx.shared_pallete());
+  EXPECT_TRUE(parser.parse(buf.data(), buf.size()) == pcx);
+}
+
+TEST(test_pcx, move_without_copy) {
+  static constexpr std::string_view kfmpcx = "assets/good/kfm.pcx"sv;
+
+  static_assert(std::is_nothrow_move_constructible_v<mugen::pcx::Pcx>);
+  static_assert(std::is_nothrow_move_assignable_v<mugen::pcx::Pcx>);
+
+  std::ifstream ifs{kfmpcx.data(), std::ios_base::binary};
+  std::vector<std::uint8_t> buf{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  std::vector<mugen::pcx::Pcx> pcxs;
+  pcxs.reserve(1);
+
+  // インデックス と 共有パレット の2回、遅延展開用の領域は展開するまで確保しない
+  auto before = allocations.load();
+  auto pcx = parser.parse(buf.data(), buf.size());
+  EXPECT_EQ(allocations.load() - before, 2);
+
+  const auto* indexes = pcx.indexes()->data();
+
+  // 予約済みのコンテナへの追加では確保が発生しない
+  before = allocations.load();
+  pcxs.push_back(std::move(pcx));
+  EXPECT_EQ(allocations.load() - before, 0);
+  EXPECT_EQ(pcxs[0].indexes()->data(), indexes);
+
+  // 再確保時も要素は複製されずに移動される
+  before = allocations.load();
+  pcxs.push_back(parser.parse(buf.data(), buf.size()));
+  EXPECT_EQ(allocations.load() - before, 3);
+  EXPECT_EQ(pcxs[0].indexes()->data(), indexes);
+
+  // 24bit 形式の構築でも、planes() を呼び出すまでは確保しない
+  static_assert(std::is_nothrow_constructible_v<mugen::pcx::Pcx, std::size_t, std::size_t, std::size_t, std::vector<mugen::pcx::Pcx::Pixel>&&>);
+  std::vector<mugen::pcx::Pcx::Pixel> data(4);
+  before = allocations.load();
+  mugen::pcx::Pcx truecolor{2, 2, 2, std::move(data)};
+  EXPECT_EQ(allocations.load() - before, 0);
+}
+
+TEST(test_pcx, parse_into_without_allocation) {
+  static constexpr std::string_view pcxs[] = {"assets/good/kfm.pcx"sv, "assets/good/test24bits.pcx"sv};
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  for (auto&& path : pcxs) {
+    std::ifstream ifs{path.data(), std::ios_base::binary};
+    std::vector<std::uint8_t> buf{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+
+    auto info = parser.probe(buf.data(), buf.size());
+    std::vector<std::uint8_t> indexes(info.size());
+    std::array<mugen::pcx::Pcx::Pixel, 256> pallete{};
+    std::vector<mugen::pcx::Pcx::Pixel> data(info.size());
+    std::vector<std::uint8_t> line(info.line_size());
+
+    auto before = allocations.load();
+    parser.parse_into(buf.data(), buf.size(), mugen::pcx::PcxBuffers{.indexes = indexes, .pallete = pallete, .data = data, .line = line});
+    EXPECT_EQ(allocations.load() - before, 0) << path;
+  }
+}
@@ -23,8 +23,11 @@
 
 #include <mpcxparser/mpcxparser.h>
 
+#include <algorithm>
 #include <ios>
+#include <span>
 #include <sstream>
+#include <stdexcept>
 #include <string_view>
 #include <utility>
 
@@ -197,6 +200,20 @@ TEST(test_write, write_as_pcx24bits) {
   }
 }
 
+TEST(test_write, write_planar_as_pcx24bits) {
+  static constexpr std::string_view testpcx = "assets/good/test24bits.pcx"sv;
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  auto planar = mugen::pcx::PcxParserWin{mugen::pcx::ParseOptions{.pixelLayout = mugen::pcx::PixelLayout::Planar}};
+  auto expected = parser.parse(testpcx);
+
+  std::stringstream ss{};
+  EXPECT_NO_THROW(planar.parse(testpcx).write_as_pcx(ss));
+
+  ss.seekg(0, std::ios_base::beg);
+  EXPECT_TRUE(parser.parse(ss) == expected);
+}
+
 TEST(test_write, write_as_ico_small) {
   static constexpr std::size_t width = 4;
   static constexpr std::size_t height = 10;
@@ -379,3 +396,211 @@ TEST(test_write, write_to_stream_win) {
     }
   }
 }
+
+TEST(test_write, write_large_to_stream_win) {
+  static constexpr std::size_t width = 320;
+  static constexpr std::size_t height = 240;
+
+  std::array<mugen::pcx::Pcx::Pixel, 256> pallete{};
+  std::vector<std::uint8_t> indexes(width * height);
+  std::vector<mugen::pcx::Pcx::Pixel> data(width * height);
+
+  // 出力が作業領域の大きさを超えるように、ランになりにくい値で埋める
+  for (std::size_t i = 0; i < indexes.size(); ++i) {
+    indexes[i] = static_cast<std::uint8_t>(i * 7 + i / 5);
+    data[i].red = static_cast<std::uint8_t>(i);
+    data[i].green = static_cast<std::uint8_t>(i * 3);
+    data[i].blue = static_cast<std::uint8_t>(i / 3);
+  }
+
+  mugen::pcx::Pcx pcx8{width, height, width, std::move(pallete), std::move(indexes)};
+  mugen::pcx::Pcx pcx24{width, height, width, std::move(data)};
+
+  auto parser = mugen::pcx::PcxParserWin{};
+  for (auto* pcx : {&pcx8, &pcx24}) {
+    std::stringstream ss{};
+    pcx->write_as_pcx(ss);
+    ss.seekg(0, std::ios_base::beg);
+
+    // パレットの 0 番目の透明度は読み込み時に設定されるため、インデックスとデータで比較する
+    auto saved = parser.parse(ss);
+    if (pcx->indexes()) {
+      EXPECT_EQ(*(saved.indexes()), *(pcx->indexes()));
+    } else {
+      EXPECT_EQ(saved.data(), pcx->data());
+    }
+
+    std::stringstream bmp{};
+    pcx->write_as_bmp(bmp);
+    EXPECT_EQ(bmp.str().size(), 14 + 40 + width * height * 4);
+  }
+}
+
+TEST(test_write, encode_to_memory_win) {
+  auto parser = mugen::pcx::PcxParserWin{};
+  for (auto path : {"assets/good/test256.pcx"sv, "assets/good/test24bits.pcx"sv, "assets/good/testEGA16.pcx"sv}) {
+    auto pcx = parser.parse(path);
+
+    std::stringstream pcxStream{}, palletelessStream{}, bmpStream{}, abmpStream{};
+    pcx.write_as_pcx(pcxStream);
+    pcx.write_as_pcx_without_pallete(palletelessStream);
+    pcx.write_as_bmp(bmpStream);
+    pcx.write_as_abmp(abmpStream);
+
+    auto expect_encoded = [](const std::stringstream& expected, const std::vector<std::uint8_t>& encoded) {
+      auto str = expected.str();
+      ASSERT_EQ(encoded.size(), str.size());
+      EXPECT_TRUE(std::equal(encoded.begin(), encoded.end(), reinterpret_cast<const std::uint8_t*>(str.data())));
+    };
+
+    expect_encoded(pcxStream, pcx.encode_as_pcx());
+    expect_encoded(palletelessStream, pcx.encode_as_pcx_without_pallete());
+    expect_encoded(bmpStream, pcx.encode_as_bmp());
+    expect_encoded(abmpStream, pcx.encode_as_abmp());
+
+    // bmp 形式は出力するバイト数ちょうどで確保される
+    EXPECT_EQ(pcx.encode_as_bmp().capacity(), bmpStream.str().size());
+
+    auto encoded = pcx.encode_as_pcx();
+    std::vector<std::uint8_t> buffer(encoded.size());
+    EXPECT_EQ(pcx.encode_as_pcx(buffer), encoded.size());
+    EXPECT_EQ(buffer, encoded);
+
+    // バッファが不足する場合は送出する
+    EXPECT_THROW(pcx.encode_as_pcx(std::span{buffer}.first(buffer.size() - 1)), std::invalid_argument);
+  }
+}
+
+TEST(test_write, encode_as_ico_to_memory) {
+  for (std::size_t size : {4, 64}) {
+    std::array<mugen::pcx::Pcx::Pixel, 256> pallete{};
+    std::vector<std::uint8_t> indexes(size * size);
+    for (std::size_t i = 0; i < indexes.size(); ++i) {
+      indexes[i] = static_cast<std::uint8_t>(i);
+    }
+
+    mugen::pcx::Pcx pcx{size, size, size, std::move(pallete), std::move(indexes)};
+
+    std::stringstream ss{};
+    pcx.write_as_ico(ss);
+    auto str = ss.str();
+
+    auto encoded = pcx.encode_as_ico();
+    EXPECT_EQ(encoded.capacity(), str.size());
+    ASSERT_EQ(encoded.size(), str.size());
+    EXPECT_TRUE(std::equal(encoded.begin(), encoded.end(), reinterpret_cast<const std::uint8_t*>(str.data())));
+
+    std::vector<std::uint8_t> buffer(encoded.size() + 16);
+    EXPECT_EQ(pcx.encode_as_ico(buffer), encoded.size());
+    EXPECT_TRUE(std::equal(encoded.begin(), encoded.end(), buffer.begin()));
+  }
+}
+
+TEST(test_write, write_runs_as_pcx) {
+  static constexpr std::size_t width = 100;
+  static constexpr std::size_t height = 2;
+
+  // 0x3F を超えるラン、0xC0 以上の単独の値、ランにならない値を並べる
+  std::vector<std::uint8_t> line(width);
+  std::fill_n(line.begin(), 70, std::uint8_t{5});
+  line[70] = 0xC5;
+  for (std::size_t x = 71; x < width; ++x) {
+    line[x] = static_cast<std::uint8_t>(x % 2 + 1);
+  }
+
+  std::vector<std::uint8_t> expected{0xFF, 5, 0xC7, 5, 0xC1, 0xC5};
+  for (std::size_t x = 71; x < width; ++x) {
+    expected.push_back(line[x]);
+  }
+
+  std::vector<std::uint8_t> indexes{};
+  for (std::size_t y = 0; y < height; ++y) {
+    indexes.insert(indexes.end(), line.begin(), line.end());
+  }
+
+  mugen::pcx::Pcx pcx{width, height, width, std::array<mugen::pcx::Pcx::Pixel, 256>{}, std::move(indexes)};
+
+  // ランは行をまたがない
+  auto encoded = pcx.encode_as_pcx_without_pallete();
+  ASSERT_EQ(encoded.size(), 128 + expected.size() * height + 1);
+  for (std::size_t y = 0; y < height; ++y) {
+    auto begin = encoded.begin() + 128 + expected.size() * y;
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), begin));
+  }
+  EXPECT_EQ(encoded.back(), 0x0C);
+}
+
+TEST(test_write, write_odd_width_as_pcx24bits) {
+  static constexpr std::size_t width = 45;
+  static constexpr std::size_t height = 3;
+
+  // SIMD の幅で割り切れない行でも、行ごとに R/G/B のプレーンへ分けて出力される
+  std::vector<mugen::pcx::Pcx::Pixel> data(width * height);
+  for (std::size_t i = 0; i < data.size(); ++i) {
+    data[i].red = static_cast<std::uint8_t>(i);
+    data[i].green = static_cast<std::uint8_t>(i / 4);
+    data[i].blue = static_cast<std::uint8_t>(0xC0 + i % 3);
+    data[i].alpha = 255;
+  }
+
+  mugen::pcx::Pcx pcx{width, height, width, std::vector<mugen::pcx::Pcx::Pixel>{data}};
+
+  std::stringstream ss{};
+  pcx.write_as_pcx(ss);
+  ss.seekg(0, std::ios_base::beg);
+
+  auto saved = mugen::pcx::PcxParserWin{}.parse(ss);
+  EXPECT_EQ(saved.data(), data);
+}
+
+TEST(test_write, write_ico_and_mask) {
+  static constexpr std::size_t width = 40;
+  static constexpr std::size_t height = 20;
+
+  // 0 番目の色のピクセルのみ透過する
+  std::vector<std::uint8_t> indexes(width * height, 1);
+  indexes[0 * width + 0] = 0;
+  indexes[0 * width + 39] = 0;
+  indexes[5 * width + 9] = 0;
+  indexes[19 * width + 32] = 0;
+
+  mugen::pcx::Pcx pcx{width, height, width, std::array<mugen::pcx::Pcx::Pixel, 256>{}, std::move(indexes)};
+  auto encoded = pcx.encode_as_ico();
+
+  // ANDマスクは 1 行 8 バイト（4 バイトにアライメント調整）で、下の行から並ぶ
+  static constexpr std::size_t lineSize = 8;
+  static constexpr std::size_t offset = 22 + 40 + 256 * 4 + width * height;
+  ASSERT_EQ(encoded.size(), offset + lineSize * height);
+
+  std::vector<std::uint8_t> expected(lineSize * height, 0);
+  expected[(height - 1 - 0) * lineSize + 0] = 0x80;
+  expected[(height - 1 - 0) * lineSize + 4] = 0x01;
+  expected[(height - 1 - 5) * lineSize + 1] = 0x40;
+  expected[(height - 1 - 19) * lineSize + 4] = 0x80;
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), encoded.begin() + offset));
+}
+
+TEST(test_write, write_zero_bytes_per_line_as_pcx) {
+  // bytesPerLine が 0 の場合、先頭の 1 バイトだけを単独で出力し、以降は行をまたいでランを続ける
+  std::vector<std::uint8_t> indexes{1, 1, 1, 1, 1, 2, 0xC3, 2};
+  mugen::pcx::Pcx pcx8{4, 2, 0, std::array<mugen::pcx::Pcx::Pixel, 256>{}, std::move(indexes)};
+
+  std::vector<std::uint8_t> expected8{0x01, 0xC4, 0x01, 0x02, 0xC1, 0xC3, 0x02, 0x0C};
+  auto encoded8 = pcx8.encode_as_pcx_without_pallete();
+  ASSERT_EQ(encoded8.size(), 128 + expected8.size());
+  EXPECT_TRUE(std::equal(expected8.begin(), expected8.end(), encoded8.begin() + 128));
+
+  std::vector<mugen::pcx::Pcx::Pixel> data(4);
+  for (auto&& pixel : data) {
+    pixel.red = 5;
+    pixel.green = 5;
+    pixel.blue = 5;
+    pixel.alpha = 255;
+  }
+  mugen::pcx::Pcx pcx24{2, 2, 0, std::move(data)};
+
+  std::vector<std::uint8_t> expected24{0x05, 0xCB, 0x05};
+  auto encoded24 = pcx24.encode_as_pcx();
+  ASSERT_EQ(encoded24.size(), 128 + expected24.size());
+  EXPECT_TRUE(std::equal(expected24.begin(), expected24.end(), encoded24.begin() + 128));
+}